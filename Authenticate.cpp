@@ -110,6 +110,16 @@ int main(int argc, const char **argv)
   // If checksum complete (file exists, etc.), check blockchain
   printf("  File %s\n  SHA256 checksum: %s\n", argv[1], buf);
 
+  // Reuse the DNS and TLS session of the last run, if a runtime dir
+  const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+  if (runtimeDir && runtimeDir[0])
+  {
+    char cacheFile[512];
+    snprintf(cacheFile, sizeof(cacheFile), "%s/%s", runtimeDir,
+             ETHEREUM_SESSION_CACHE);
+    EthereumSetSessionCache(cacheFile);
+  }
+
   // Lookup the file information from the SHA256 checksum
   res = EthereumAuthenticateFile((const char *)buf, argv[2], &entityId, &productId,
                                  &releaseId, &languages, &version, uri);
@@ -142,6 +152,16 @@ int main(int argc, const char **argv)
       printf("ERROR - Release not found for SHA256 checksum of this file");
     else if (res == blockchainAuthenticationFailed)
       printf("ERROR - Infura or HTTPS error. Is the Infura product id correct?");
+    else if (res == rateLimited)
+      printf("ERROR - Daily quota or rate limit of the endpoint reached");
+    else if (res == uriTooLong)
+      printf("ERROR - Release URI too long, truncated to %s", uri);
+    else if (res == timedOut)
+      printf("ERROR - The endpoint did not answer in time");
+    else if (res == requestRejected)
+      printf("ERROR - The endpoint rejected the request. Is the URL or Infura product id correct?");
+    else if (res == endpointUnavailable)
+      printf("ERROR - The endpoint is failing, try again later");
     else
       printf(" ERROR - File unverified, error %d!\n", res);
   }
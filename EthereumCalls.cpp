@@ -31,12 +31,24 @@
 /*                                                                     */
 /***********************************************************************/
 #include <errno.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <memory.h>
 #include <ctype.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 #include "autolm.h"
 
 #ifdef _MINGW
@@ -46,8 +58,604 @@
 
 #include "curl/curl.h"
 
-#define MAX_SIZE_JSON_RESPONSE     1024
+#ifdef _WINDOWS
+#include <windows.h>
+#endif
+
+// JSON-RPC over a Unix domain socket (IPC) to a local node, cache
+//   files readable only by the owner and the shared memory cache
+#if defined(_UNIX) && !defined(_WINDOWS)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define ETHEREUM_IPC               1
+#define ETHEREUM_PRIVATE_FILES     1
+#define ETHEREUM_SHARED_CACHE      1
+#endif
+
+// TLS sessions can be exported to (and imported from) the cache file
+#if LIBCURL_VERSION_NUM >= 0x080c00
+#define ETHEREUM_TLS_SESSIONS      1
+#endif
+
+// Contract logs are subscribed to over a WebSocket, polling its socket
+#if defined(ETHEREUM_IPC) && (LIBCURL_VERSION_NUM >= 0x080b00)
+#define ETHEREUM_WEBSOCKET         1
+#endif
+
 #define BLOCK_CHAIN_CHAR           ':' /* use colon as special char */
+#define MAX_SIZE_JSON_BATCH_ITEM   512 /* request bytes per batch item */
+#define MAX_POOLED_HANDLES         8   /* idle handles kept per endpoint */
+#define MULTICALL_CALL3_SIZE       256 /* bytes of each encoded Call3 */
+#define MAX_SIZE_URL               (ETHEREUM_URL_SIZE + 64) /* and Id */
+#define ENDPOINT_EWMA_WEIGHT       0.2 /* weight of the newest latency */
+#define ENDPOINT_RECHECK_SECONDS   30  /* retry failed endpoint after */
+#define ENDPOINT_BREAKER_FAILURES  3   /* failures in a row to open it */
+#define ENDPOINT_BREAKER_DOUBLINGS 4   /* most doublings of open period */
+#define ENDPOINT_LATENCY_SAMPLES   64  /* latencies kept for percentile */
+#define HEDGE_MIN_SAMPLES          8   /* samples before percentile used */
+#define HEDGE_DEFAULT_DELAY_MS     500 /* hedge delay until then */
+#define QUOTA_RESERVE_PERCENT      10  /* daily quota kept for priority */
+#define RATE_LIMIT_MAX_WAIT_MS     2000 /* longest wait for a token */
+#define RETRY_BACKOFF_MS           100 /* first retry backoff, doubled */
+#define PREWARM_MAX_WAIT_MS        2000 /* longest wait for a prewarm */
+#define SECONDS_PER_DAY            (24 * 60 * 60)
+#define IPC_URL_PREFIX             "ipc://" /* endpoint is a local socket */
+#define IPC_TIMEOUT_MS             10000 /* longest wait for the node */
+#define IPC_READ_SIZE              4096 /* bytes read from the socket */
+#define SUBSCRIBE_READ_SIZE        4096 /* bytes read from the WebSocket */
+#define SUBSCRIBE_POLL_MS          100 /* unsubscribe check interval */
+#define SUBSCRIBE_BACKOFF_MAX_MS   30000 /* longest wait to reconnect */
+#define SYNC_STALE_INTERVALS       3   /* index unused if not synced in */
+#define SYNC_LOGGED_SLOTS          1024 /* blocks of hashes named in logs */
+#define SESSION_DNS_TTL_SECONDS    300 /* cached host address lifetime */
+#define DEADLINE_CONNECT_PERCENT   50  /* of time left, for the connect */
+#define DEADLINE_POLL_MS           10  /* cancellation check interval */
+#define CACHE_MAX_ENTRIES          1024 /* activations kept in the cache */
+#define NEGATIVE_MAX_ENTRIES       256 /* not found results kept */
+#define CACHE_FILE_RECORDS         64  /* activations in the cache file */
+#define CACHE_FILE_MAGIC           "AUTOLMC2" /* cache file format */
+#define CACHE_REVALIDATE_SECONDS   60  /* between background validations */
+#define SHARED_CACHE_SLOTS         256 /* results in the shared segment */
+#define SHARED_CACHE_WAYS          4   /* slots a result may be stored in */
+#define SHARED_CACHE_READS         3   /* tries of a slot being written */
+#define SHARED_CACHE_MAGIC         "AUTOLMS2" /* shared segment format */
+#define SHARED_ACTIVATION          1   /* slot kind, activation result */
+#define SHARED_RELEASE             2   /* slot kind, file authentication */
+#define SNAPSHOT_MAGIC             "AUTOLMX1" /* snapshot file format */
+#define FILTER_MAGIC               "AUTOLMB2" /* filter file format */
+#define FILTER_PRODUCTS_MAX        1024 /* most products of a filter */
+#define FILTER_HASHES_MAX          16  /* most bits set by an activation */
+
+// Request priority, low priority requests are refused when the daily
+//   quota runs low and never wait for the rate limit
+enum RequestPriority
+{
+  priorityHigh = 0,
+  priorityLow
+};
+
+// Use of a pooled easy handle. A request waits for a handle that is
+//   being prewarmed (connected) rather than connecting again, except
+//   on the event loop thread, which must never block.
+enum HandleUse
+{
+  handleRequest = 0,
+  handleAsync,
+  handlePrewarm
+};
+
+// Size of the aggregate3() hex parameters for count activations
+#define MULTICALL_PARAMS_SIZE(count) \
+          (10 + (2 * 2 * 32) + ((count) * 2 * (32 + MULTICALL_CALL3_SIZE)) + 1)
+
+/***********************************************************************/
+/* Local variables                                                     */
+/***********************************************************************/
+
+// Process-wide pool of idle curl easy handles, keyed by endpoint URL.
+//   Each easy handle owns a connection and DNS cache, so reusing the
+//   handle keeps the TCP/TLS connection to the endpoint alive.
+static std::mutex CurlPoolLock;
+static std::map<std::string, std::vector<CURL*> > CurlPool;
+static std::map<std::string, int> CurlPrewarming;
+static std::condition_variable CurlPrewarmed;
+static struct curl_slist* CurlJsonHeaders = NULL;
+static bool CurlInitialized = false;
+
+// DNS results and TLS sessions shared by every easy handle, so a new
+//   handle (or a new connection) resumes the TLS session of the host
+static CURLSH* CurlShare = NULL;
+static std::mutex CurlShareLocks[CURL_LOCK_DATA_LAST];
+
+// Process-wide pool of idle IPC sockets, keyed by socket path. A local
+//   node answers the requests of a socket in order, one at a time.
+static std::mutex IpcPoolLock;
+static std::map<std::string, std::vector<int> > IpcPool;
+
+// JSON-RPC request identifier, unique for each request of the process
+static std::atomic<ui32> JsonRpcId(1);
+
+/***********************************************************************/
+/* Type Definitions                                                    */
+/***********************************************************************/
+
+/*
+** Keys of a JSON-RPC response object that are parsed
+*/
+enum JsonKey
+{
+  jsonKeyOther = 0,
+  jsonKeyId,
+  jsonKeyResult
+};
+
+/*
+** JSON-RPC response object, the result hex is in the JsonResponse
+*/
+typedef struct JsonResult
+{
+  ui32 id;           /* the JSON-RPC id of the response */
+  bool found;        /* true if the response has a "result" string */
+  size_t offset;     /* offset of the result in the JsonResponse hex */
+  size_t length;     /* the number of result hex digits, without 0x */
+} JsonResult;
+
+/*
+** HTTP response, parsed by curl_write_memory_callback as it arrives
+*/
+typedef struct JsonResponse
+{
+  std::string hex;                 /* result hex digits of all objects */
+  std::vector<JsonResult> results; /* each response object, in order */
+  int depth;           /* nesting within the current response object */
+  bool inString;       /* within a JSON string */
+  bool escape;         /* the previous string character was a '\' */
+  bool expectKey;      /* the next string is a key of the object */
+  int key;             /* the JsonKey of the value being parsed */
+  char keyName[8];     /* the key being parsed, if short */
+  size_t keyLength;    /* the length of the key being parsed */
+  size_t valueLength;  /* the length of the string value being parsed */
+  bool batch;          /* the response is a batch array */
+  bool complete;       /* the whole response (object or array) parsed */
+  bool keepBody;       /* keep the whole body too, for eth_getLogs */
+  std::string body;    /* the whole body, if keepBody */
+
+  JsonResponse() : depth(0), inString(false), escape(false),
+                   expectKey(false), key(jsonKeyOther), keyLength(0),
+                   valueLength(0), batch(false), complete(false),
+                   keepBody(false) {}
+} JsonResponse;
+
+/*
+** JSON-RPC endpoint of the provider pool
+*/
+typedef struct EthereumEndpoint
+{
+  std::string url;   /* the base URL of the endpoint */
+  bool appendId;     /* append the provider (Infura) Id to the URL */
+  bool healthy;      /* false after a failure, until it succeeds again */
+  time_t failed;     /* the time of the last failure */
+  ui32 failures;     /* transient failures in a row, opens the breaker */
+  ui32 trips;        /* failed probes in a row of the open breaker */
+  time_t reopen;     /* the open breaker lets one probe through after */
+  double latency;    /* EWMA of the request latency, in milliseconds */
+  ui32 requests;     /* the number of successful requests */
+  double samples[ENDPOINT_LATENCY_SAMPLES]; /* latest latencies (ring) */
+  double rate;       /* token bucket rate, requests/second (0 = none) */
+  double burst;      /* token bucket size, most requests at once */
+  double tokens;     /* tokens in the bucket, one used per request */
+  std::chrono::steady_clock::time_point refilled; /* last refill */
+  ui32 quota;        /* requests per (UTC) day, zero if unlimited */
+} EthereumEndpoint;
+
+/*
+** Requests sent to an endpoint today, persisted in the quota file
+*/
+typedef struct QuotaCount
+{
+  int day;           /* the UTC day number of the count */
+  ui32 used;         /* the requests sent on that day */
+} QuotaCount;
+
+/*
+** Address of a host, persisted in the session cache file
+*/
+typedef struct SessionHost
+{
+  std::string address; /* the IP address connected to */
+  time_t expires;      /* when the address is resolved again */
+} SessionHost;
+
+#ifdef ETHEREUM_TLS_SESSIONS
+/*
+** TLS session of a host, persisted in the session cache file
+*/
+typedef struct SessionTicket
+{
+  std::string key;     /* the session key, or empty if hashed */
+  std::string shmac;   /* the salted hash of the key, if any */
+  std::string data;    /* the TLS session data */
+  time_t validUntil;   /* when the session can no longer be resumed */
+} SessionTicket;
+#endif
+
+/*
+** One of the two requests of a hedged JSON-RPC call
+*/
+typedef struct HedgeRequest
+{
+  std::shared_ptr<EthereumEndpoint> endpoint; /* endpoint posted to */
+  CURL* easy;             /* the easy handle of the request, or NULL */
+  char url[MAX_SIZE_URL]; /* the full endpoint URL posted to */
+  JsonResponse response;  /* the parsed HTTP response of this request */
+  bool done;              /* true when the request completed */
+  int result;             /* zero if the request succeeded */
+} HedgeRequest;
+
+/*
+** Asynchronous request, driven by the curl multi event loop
+*/
+typedef struct AsyncTransfer
+{
+  CURL* easy;                    /* the easy handle of the request */
+  std::string url;               /* the endpoint URL posted to */
+  std::string infuraId;          /* the provider Id of the endpoint */
+  EthereumNetwork network;       /* the network url, if not the pool */
+  std::shared_ptr<EthereumEndpoint> endpoint; /* endpoint posted to */
+  std::vector<EthereumEndpoint*> tried;       /* endpoints that failed */
+  std::string jsonData;          /* the JSON-RPC request */
+  JsonResponse response;         /* the parsed HTTP response */
+  EthereumActivationCallback activationCallback; /* activation or */
+  EthereumReleaseCallback releaseCallback;       /* release lookup */
+  EthereumActivation activation; /* the activation result */
+  EthereumRelease release;       /* the release result */
+  void* context;                 /* the caller context of callback */
+  int ipcResult;                 /* the result of a local node (IPC) */
+
+  AsyncTransfer() : easy(NULL), activationCallback(NULL),
+                    releaseCallback(NULL), context(NULL), ipcResult(0)
+  {
+    memset(&network, 0, sizeof(network));
+    memset(&activation, 0, sizeof(activation));
+    memset(&release, 0, sizeof(release));
+  }
+} AsyncTransfer;
+
+/*
+** Activation lookup in flight, shared by identical concurrent lookups
+*/
+typedef struct ActivationFlight
+{
+  bool done;         /* true when the result below is available */
+  bool bounded;      /* true if the lookup had a caller deadline */
+  int result;        /* the AutoLmResponse of the activation */
+  time_t exp_date;   /* expiration date of the activation (or 0) */
+  ui64 languages;    /* language flags of the activation */
+  ui64 version_plat; /* version and platform flags */
+  ui64 block;        /* chain head when looked up, zero if unknown */
+
+  ActivationFlight() : done(false), bounded(false),
+                       result(otherLicenseError), exp_date(0),
+                       languages(0), version_plat(0), block(0) {}
+} ActivationFlight;
+
+/*
+** Valid activation in the cache, see EthereumSetCacheTtl()
+*/
+typedef struct ActivationCached
+{
+  ActivationFlight found; /* the result of the lookup */
+  time_t fresh;           /* served until, the TTL or expiration date */
+  time_t validated;       /* time of the lookup */
+} ActivationCached;
+
+/*
+** Not found (or expired) result in the negative cache, see
+**   EthereumSetNegativeCacheTtl()
+*/
+typedef struct NegativeCached
+{
+  int result;             /* blockchainExpiredLicense or blockchainNotFound */
+  time_t fresh;           /* served until, the negative TTL */
+  ui64 block;             /* chain head when looked up, zero if unknown */
+} NegativeCached;
+
+/*
+** Latest block number of a network, see EthereumSetBlockPolling()
+*/
+typedef struct ChainHead
+{
+  ui64 number;            /* the block number, zero if the poll failed */
+  std::chrono::steady_clock::time_point polled; /* time of the poll */
+  bool polling;           /* a caller is polling, the others do not wait */
+} ChainHead;
+
+/*
+** Background validation of a cached activation
+*/
+typedef struct ActivationRevalidation
+{
+  std::string key;        /* the key of the activation lookup */
+  ui64 block;             /* chain head when started, zero if unknown */
+} ActivationRevalidation;
+
+/*
+** Activation of the synced entity in the local index, see
+**   EthereumStartSync()
+*/
+typedef struct SyncedActivation
+{
+  ui64 productId;         /* the product of the activation */
+  ActivationFlight found; /* the result of the last validation */
+} SyncedActivation;
+
+/*
+** Snapshot file header, followed by the records sorted by hash and the
+**   HMAC-SHA1 of the header and records. Numbers are little endian.
+*/
+typedef struct SnapshotHeader
+{
+  char magic[8];          /* SNAPSHOT_MAGIC */
+  ui64 entityId;          /* the entity of every activation */
+  ui64 block;             /* the block synced to when exported */
+  ui64 created;           /* time exported */
+  ui64 records;           /* the number of records */
+} SnapshotHeader;
+
+/*
+** Snapshot file record of a valid activation
+*/
+typedef struct SnapshotRecord
+{
+  ui8 hash[32];           /* activation hash, big endian, the sort key */
+  ui64 productId;         /* the product of the activation */
+  ui64 exp_date;          /* expiration date of the activation (or 0) */
+  ui64 languages;         /* language flags of the activation */
+  ui64 version_plat;      /* version and platform flags */
+  ui64 result;            /* licenseValid or applicationFeature */
+} SnapshotRecord;
+
+/*
+** Filter file header, followed by the filtered product Ids, the bits of
+**   the Bloom filter (as 64 bit words) and the HMAC-SHA1 of the header,
+**   products and bits. Numbers are little endian.
+*/
+typedef struct FilterHeader
+{
+  char magic[8];          /* FILTER_MAGIC */
+  ui64 entityId;          /* the entity of every activation */
+  ui64 block;             /* the block synced to when built */
+  ui64 created;           /* time built (or last synced) */
+  ui64 products;          /* the number of product Ids */
+  ui64 bits;              /* the number of bits, a multiple of 64 */
+  ui64 hashes;            /* the bits set by each activation */
+  ui64 seed;              /* the seed of the bit positions */
+} FilterHeader;
+
+/*
+** Cache file header, followed by CACHE_FILE_RECORDS records (or of the
+**   shared memory segment, followed by SHARED_CACHE_SLOTS slots)
+*/
+typedef struct CacheFileHeader
+{
+  char magic[8];          /* CACHE_FILE_MAGIC or SHARED_CACHE_MAGIC */
+  ui32 records;           /* the number of records (or slots) */
+  ui32 reserved;
+} CacheFileHeader;
+
+/*
+** Valid activation in the cache file, authenticated with an HMAC
+*/
+typedef struct CacheFileRecord
+{
+  ui64 exp_date;          /* expiration date of the activation (or 0) */
+  ui64 languages;         /* language flags of the activation */
+  ui64 version_plat;      /* version and platform flags */
+  ui64 validated;         /* time validated on-chain, zero if unused */
+  ui64 hash;              /* the hash_tag() of the activation hash */
+  ui8 key[SHAHASHBYTES];  /* SHA1 of the key of the activation lookup */
+  int result;             /* the AutoLmResponse of the activation */
+  ui8 mac[SHAHASHBYTES];  /* HMAC-SHA1 of the members above */
+} CacheFileRecord;
+
+/*
+** Result in the shared memory cache, written under a sequence lock
+*/
+typedef struct SharedCacheSlot
+{
+  ui32 sequence;          /* odd while being written, see shared_cache_* */
+  ui32 kind;              /* SHARED_ACTIVATION, SHARED_RELEASE or zero */
+  ui64 fresh;             /* served until, the TTL or expiration date */
+  ui64 values[5];         /* exp_date, languages, version_plat and the */
+                          /*   hash_tag() of an activation, or entity, */
+                          /*   product, release, languages and version */
+                          /*   of a file authentication */
+  ui8 key[SHAHASHBYTES];  /* SHA1 of the key of the lookup */
+  int result;             /* the AutoLmResponse of the lookup */
+  char uri[ETHEREUM_URI_SIZE]; /* release URI of a file authentication */
+  ui8 mac[SHAHASHBYTES];  /* HMAC-SHA1 of kind to uri */
+} SharedCacheSlot;
+
+// Activation lookups in flight, keyed by "entityId:productId:hashId".
+//   Concurrent callers of the same activation wait for one request.
+static std::mutex FlightLock;
+static std::condition_variable FlightDone;
+static std::map<std::string, std::shared_ptr<ActivationFlight> > Flights;
+
+// Valid activations, keyed as the lookups in flight. A cached result is
+//   served until the TTL or the on-chain expiration date, whichever is
+//   first, and past the TTL only if every circuit breaker is open.
+static std::mutex CacheLock;
+static std::map<std::string, ActivationCached> ActivationCache;
+static std::atomic<ui32> CacheTtl(ETHEREUM_CACHE_TTL_SECONDS);
+
+// Percent of the TTL after which a cached result is validated again in
+//   the background (zero if not), see EthereumSetCacheRefresh(). The
+//   time of the last background validation of each lookup is guarded
+//   by CacheLock.
+static std::atomic<ui32> CacheRefresh(0);
+static std::map<std::string, time_t> CacheRevalidated;
+
+// Cached results are fresh until the chain head moves when polling the
+//   block number, at most once per interval (milliseconds, zero if not
+//   polling). The head of each network (by URL) is guarded by HeadLock,
+//   released while one caller polls, the others use the last head.
+static std::atomic<ui32> BlockPollMs(0);
+static std::mutex HeadLock;
+static std::map<std::string, ChainHead> ChainHeads;
+
+// The thread subscribed to the logs of the activate contract, see
+//   EthereumSubscribeActivations(). Started and stopped under
+//   SubscribeLock.
+static std::mutex SubscribeLock;
+static std::thread SubscribeThread;
+static std::atomic<bool> SubscribeRunning(false);
+
+// The eth_getLogs sync of the activations of one entity into a local
+//   index, keyed by activation hash (64 hex digits), see
+//   EthereumStartSync(). The thread is started and stopped under
+//   SyncLock, the index and the sync state are guarded by SyncIndexLock.
+static std::mutex SyncLock;
+static std::thread SyncThread;
+static std::atomic<bool> SyncRunning(false);
+static std::mutex SyncIndexLock;
+static std::map<std::string, SyncedActivation> SyncIndex;
+static std::vector<ui64> SyncProducts;
+static std::string SyncUrl;
+static ui64 SyncEntity = 0;
+static ui32 SyncInterval = 0;
+static ui64 SyncBlock = 0;
+static bool SyncCurrent = false;
+static bool SyncComplete = false; // backfilled from the contract deploy
+static ui64 SyncLogged[SYNC_LOGGED_SLOTS]; // by hash_tag(), see sync_store
+static std::chrono::steady_clock::time_point SyncSynced;
+
+// Activations not on-chain (or expired) and releases not found, keyed
+//   as the lookups, so clients retrying in a loop do not repeat the
+//   request. A purchase clears them, see EthereumClearNegativeCache().
+//   Guarded by CacheLock.
+static std::map<std::string, NegativeCached> NegativeCache;
+static std::atomic<ui32> NegativeTtl(ETHEREUM_NEGATIVE_TTL_SECONDS);
+
+// The cache file, mapped into memory (or read, without mmap), its HMAC
+//   key and grace period. Guarded by CacheLock.
+static std::string CacheFileName;
+static ui8* CacheFileMap = NULL;
+static size_t CacheFileSize = 0;
+static ui8 CacheFileKey[64];
+static ui32 CacheFileKeyLength = 0;
+static ui32 CacheFileGrace = 0;
+
+// The shared memory segment of every process on the host, and its HMAC
+//   key. Guarded by CacheLock within the process, the slots are read
+//   and written by other processes without locks.
+#ifdef ETHEREUM_SHARED_CACHE
+static ui8* SharedCacheMap = NULL;
+static size_t SharedCacheSize = 0;
+#endif
+static ui8 SharedCacheKey[64];
+static ui32 SharedCacheKeyLength = 0;
+
+// The snapshot file of the activations of an entity, mapped into memory
+//   (or read, without mmap), see EthereumSetSnapshot(). Guarded by
+//   SnapshotLock.
+static std::mutex SnapshotLock;
+static ui8* SnapshotMap = NULL;
+static size_t SnapshotSize = 0;
+
+// The Bloom filter of the valid activations of the products of an
+//   entity, see EthereumSetFilter(). Activations the sync validates are
+//   added, and a filter built from the index is current while synced.
+//   Guarded by FilterLock, taken after SyncIndexLock.
+static std::mutex FilterLock;
+static std::vector<ui64> FilterBits;
+static std::vector<ui64> FilterProducts;
+static ui64 FilterEntity = 0;
+static ui64 FilterBlock = 0;
+static ui64 FilterCreated = 0;
+static ui32 FilterHashes = 0;
+static ui64 FilterSeed = 0;
+static ui32 FilterMaxAge = 0;
+static bool FilterSynced = false;
+
+/***********************************************************************/
+/* Local variables, provider pool                                      */
+/***********************************************************************/
+
+// Ordered pool of JSON-RPC endpoints, CURL_HOST_URL when none added.
+//   Each request goes to the fastest healthy endpoint and fails over
+//   to the next endpoint when the request fails.
+static std::mutex EndpointLock;
+static std::vector<std::shared_ptr<EthereumEndpoint> > Endpoints;
+
+// Endpoints of an EthereumNetwork url, keyed by URL. These are used only
+//   by calls of that network, never by the provider pool.
+static std::map<std::string, std::shared_ptr<EthereumEndpoint> >
+  NetworkEndpoints;
+
+// Percentile of endpoint latency after which a call is hedged, or zero
+static std::atomic<int> HedgePercentile(0);
+
+// Random source of the retry backoff and circuit breaker jitter
+static std::mutex JitterLock;
+static std::minstd_rand JitterRandom(std::random_device{}());
+
+// Daily requests of each endpoint URL (EndpointLock), and the file
+//   that persists them across restarts of all processes on the host.
+//   QuotaLock orders the file updates of this process, taken before
+//   (never while holding) EndpointLock.
+static std::map<std::string, QuotaCount> QuotaUsage;
+static std::string QuotaFile;
+static std::mutex QuotaLock;
+
+// Session cache file shared with the next process (CLI tools run once
+//   per check), with the host addresses and TLS sessions it holds. The
+//   loaded addresses are used, instead of DNS, until they expire.
+static std::mutex SessionLock;
+static std::string SessionFile;
+static std::map<std::string, SessionHost> SessionHosts;
+static struct curl_slist* SessionResolve = NULL;
+static time_t SessionResolveExpires = 0;
+
+// Cached addresses that failed, removed from the (shared) DNS cache by
+//   the next request. Lists set on a handle are freed at cleanup.
+static struct curl_slist* SessionRemove = NULL;
+static std::vector<struct curl_slist*> SessionRetired;
+#ifdef ETHEREUM_TLS_SESSIONS
+static std::vector<SessionTicket> SessionTickets;
+#endif
+
+/***********************************************************************/
+/* Local variables, asynchronous requests                              */
+/***********************************************************************/
+
+// The event loop thread and curl multi handle of all async requests.
+//   Requests are queued by the caller and added by the event loop.
+static std::mutex AsyncLock;
+static std::thread AsyncThread;
+static CURLM* AsyncMulti = NULL;
+static std::vector<AsyncTransfer*> AsyncQueue;
+static bool AsyncRunning = false;
+static bool AsyncStopping = false;
+
+// The thread sending the async requests to a local node (IPC), which
+//   blocks, so the event loop never waits for the node. Its results are
+//   completed by the event loop. Guarded by AsyncLock.
+static std::thread AsyncIpcThread;
+static std::condition_variable AsyncIpcWake;
+static std::vector<AsyncTransfer*> AsyncIpcQueue;
+static std::vector<AsyncTransfer*> AsyncIpcDone;
+
+// Threads connecting to an endpoint in the background (EthereumPrewarm),
+//   each pools its connection and exits
+static std::mutex PrewarmLock;
+static std::vector<std::thread> PrewarmThreads;
 
 /*
  Example command line (Entity 2, Product 0, Activation 1)
@@ -180,6 +788,74 @@ static void encode_authenticate_json(char* functionId, const char* hash,
   pack_hash_to_bytes(hash, params + nLen); //1st param
 }
 
+/***********************************************************************/
+/* encode_eth_call_json: Encode a JSON-RPC eth_call request object     */
+/*                                                                     */
+/*      Inputs: contract = the smart contract address to call          */
+/*              params = the encoded function id and parameters        */
+/*              id = the JSON-RPC request identifier                   */
+/*     Outputs: jsonData = the resulting JSON-RPC request              */
+/*                                                                     */
+/*     Returns: the length of the resulting JSON-RPC request           */
+/*                                                                     */
+/***********************************************************************/
+static int encode_eth_call_json(const char* contract, const char* params,
+                                ui32 id, char* jsonData)
+{
+  return sprintf(jsonData,
+    "{\"jsonrpc\":\"2.0\",\"method\": \"eth_call\", \"params\":[{\"to\": \"%s\", \"data\":\"%s\"}, \"latest\"],\"id\": %u}",
+    contract, params, id);
+}
+
+/***********************************************************************/
+/* network_activate_contract: The activate contract of a network       */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*                                                                     */
+/*     Returns: the contract address, IMMUTABLE_ACTIVATE_CONTRACT if   */
+/*              not set                                                */
+/*                                                                     */
+/***********************************************************************/
+static const char* network_activate_contract(const EthereumNetwork* network)
+{
+  if (network && network->activateContract[0])
+    return network->activateContract;
+  return IMMUTABLE_ACTIVATE_CONTRACT;
+}
+
+/***********************************************************************/
+/* network_creator_contract: The creator contract of a network         */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*                                                                     */
+/*     Returns: the contract address, IMMUTABLE_CREATOR_CONTRACT if    */
+/*              not set                                                */
+/*                                                                     */
+/***********************************************************************/
+static const char* network_creator_contract(const EthereumNetwork* network)
+{
+  if (network && network->creatorContract[0])
+    return network->creatorContract;
+  return IMMUTABLE_CREATOR_CONTRACT;
+}
+
+/***********************************************************************/
+/* network_multicall_contract: The Multicall3 contract of a network    */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*                                                                     */
+/*     Returns: the contract address, IMMUTABLE_MULTICALL_CONTRACT if  */
+/*              not set                                                */
+/*                                                                     */
+/***********************************************************************/
+static const char* network_multicall_contract(
+  const EthereumNetwork* network)
+{
+  if (network && network->multicallContract[0])
+    return network->multicallContract;
+  return IMMUTABLE_MULTICALL_CONTRACT;
+}
+
 #if 0 //Deprecated
 /***********************************************************************/
 /* unpack_param_value: Convert 256 bit integer hex string to ui64 value*/
@@ -239,7 +915,7 @@ static ui64 unpack_256bit_value(char* param)
 /*     Returns: the unpacked ui64 bit value of the parameter           */
 /*                                                                     */
 /***********************************************************************/
-static ui64 unpack_64bit_value(char* param)
+static ui64 unpack_64bit_value(const char* param)
 {
   ui64 ll = 0;
   int n = 0;
@@ -283,7 +959,8 @@ static ui64 unpack_64bit_value(char* param)
 /***********************************************************************/
 /* parse_activation_json: Parse resulting activateStatus() activation  */
 /*                                                                     */
-/*      Input: jsonResult = the 256 bit integer hex string             */
+/*     Inputs: hex = the result hex digits (without 0x), or NULL       */
+/*             length = the number of result hex digits                */
 /*    Outputs: exp_dat = the resulting license expiration day/time     */
 /*             languages = the resulting licensed language flags       */
 /*             version_plat = the version and platform flags           */
@@ -291,33 +968,23 @@ static ui64 unpack_64bit_value(char* param)
 /*     Returns: licenseValid on success, otherwise error               */
 /*                                                                     */
 /***********************************************************************/
-static int parse_activation_json(const char* jsonResult, time_t* exp_dat,
-                                 ui64* languages, ui64 *version_plat)
+static int parse_activation_json(const char* hex, size_t length,
+                                 time_t* exp_dat, ui64* languages,
+                                 ui64 *version_plat)
 {
-  size_t cnt = 0;
   int ret = 0;
  
-  PRINTF("parse_activation_json()\n jsonResult-%s\n", jsonResult);
+  PRINTF("parse_activation_json()\n hex-%.*s\n", (int)length,
+         hex ? hex : "");
 
   /*-------------------------------------------------------------------*/
   /* see if json result has 0x hex string                              */
   /*-------------------------------------------------------------------*/
-  if (strstr(jsonResult, "0x"))
+  if (hex)
   {
-    char tmpstr[3 * 64 + 5], s_tmp[3 * 64 + 5];
-    const char* hexstring = strstr(jsonResult, "0x");
-    strcpy(tmpstr, hexstring);
-    strcpy(s_tmp, &(tmpstr[2]));
-    strcpy(tmpstr, s_tmp);
-    if (strchr(tmpstr, '"'))
-    {
-      strchr(tmpstr, '"')[0] = 0;
-    }
-
-    cnt = strlen(tmpstr);
-    if (cnt > 0)
+    if (length > 0)
     {
-      int nParamsCount = (int)cnt / 16;
+      int nParamsCount = (int)length / 16;
       PRINTF("nParamsCount = %d\n", nParamsCount);
 
       // 2 X 256 bit parameters is 8 different 64 bit parameters
@@ -326,10 +993,8 @@ static int parse_activation_json(const char* jsonResult, time_t* exp_dat,
         ui64 llParams[8];
         for (int i = 0; i < nParamsCount; i++)
         {
-          strncpy(s_tmp, &(tmpstr[i * 16]), 16);
-          s_tmp[16] = 0;
-          PRINTF("param[%d] - %s\n", i, s_tmp);
-          llParams[i] = unpack_64bit_value(s_tmp);
+          PRINTF("param[%d] - %.16s\n", i, &hex[i * 16]);
+          llParams[i] = unpack_64bit_value(&hex[i * 16]);
         }
 
         // If entity, product and flags, expiration zero, not found
@@ -437,48 +1102,98 @@ static int parse_activation_json(const char* jsonResult, time_t* exp_dat,
   return ret;
 }
 
+/***********************************************************************/
+/* parse_abi_string: Decode an ABI encoded string of a result          */
+/*                                                                     */
+/*     Inputs: hex = the result hex digits (without 0x)                */
+/*             length = the number of result hex digits                */
+/*             word = the index of the 256 bit word with the offset    */
+/*                    of the string                                    */
+/*             size = the size of the str buffer                       */
+/*    Outputs: str = the string, NULL terminated (empty if none)       */
+/*             size = the size needed for the whole string             */
+/*                                                                     */
+/*     Returns: zero on success, uriTooLong if str was truncated,      */
+/*              otherwise blockchainAuthenticationFailed               */
+/*                                                                     */
+/***********************************************************************/
+static int parse_abi_string(const char* hex, size_t length, size_t word,
+                            char* str, size_t* size)
+{
+  size_t words = length / 64, start, bytes, copy, i;
+  char byte[3];
+
+  if (*size == 0)
+    return uriTooLong;
+  str[0] = '\0';
+
+  // No string in the result, it is empty
+  if (word >= words)
+  {
+    *size = 1;
+    return 0;
+  }
+
+  // The string length is at the offset, the characters follow it
+  start = (size_t)unpack_64bit_value(&hex[word * 64 + 48]) / 32;
+  if (start >= words)
+    return blockchainAuthenticationFailed;
+  bytes = (size_t)unpack_64bit_value(&hex[start * 64 + 48]);
+  if (bytes > (length - (start + 1) * 64) / 2)
+    return blockchainAuthenticationFailed;
+
+  // Convert each hex byte of the string that fits the buffer
+  copy = std::min(bytes, *size - 1);
+  hex = &hex[(start + 1) * 64];
+  byte[2] = '\0';
+  for (i = 0; i < copy; i++)
+  {
+    byte[0] = hex[i * 2];
+    byte[1] = hex[i * 2 + 1];
+    str[i] = (char)strtol(byte, NULL, 16);
+  }
+  str[copy] = '\0';
+
+  *size = bytes + 1;
+  return (copy < bytes) ? uriTooLong : 0;
+}
+
 /***********************************************************************/
 /* parse_authentication_json: Parse productReleaseHashDetails() result */
 /*                                                                     */
-/*      Input: jsonResult = the 256 bit integer hex string             */
+/*     Inputs: hex = the result hex digits (without 0x), or NULL       */
+/*             length = the number of result hex digits                */
+/*             uriSize = the size of the uri buffer                    */
 /*    Outputs: entityId = the resulting file entity identifier         */
 /*             productId = the resulting file product identifier       */
 /*             releaseId = the resulting file release identifier       */
 /*             languages = the resulting licensed language flags       */
 /*             version = the version of the release                    */
 /*             uri = the official URI of the file (to download)        */
+/*             uriSize = the size needed for the whole URI             */
 /*                                                                     */
-/*     Returns: licenseValid on success, otherwise error               */
+/*     Returns: licenseValid on success, uriTooLong if the URI was     */
+/*              truncated to the uri buffer, otherwise error           */
 /*                                                                     */
 /***********************************************************************/
-static int parse_authentication_json(const char *jsonResult,
+static int parse_authentication_json(const char *hex, size_t length,
                     ui64 *entityId, ui64 *productId, ui64 *releaseId,
-                    ui64 *languages, ui64 *version, char *uri)
+                    ui64 *languages, ui64 *version, char *uri,
+                    size_t *uriSize)
 {
-  size_t cnt = 0;
   int ret = 0;
 
-  PRINTF("parse_activation_json()\n jsonResult-%s\n", jsonResult);
+  PRINTF("parse_authentication_json()\n hex-%.*s\n", (int)length,
+         hex ? hex : "");
 
   /*-------------------------------------------------------------------*/
   /* see if json result has 0x hex string                              */
   /*-------------------------------------------------------------------*/
-  if (strstr(jsonResult, "0x"))
+  if (hex)
   {
-    char tmpstr[1024], s_tmp[1024];
-    const char* hexstring = strstr(jsonResult, "0x");
-    strcpy(tmpstr, hexstring);
-    strcpy(s_tmp, &(tmpstr[2]));
-    strcpy(tmpstr, s_tmp);
-    if (strchr(tmpstr, '"'))
-    {
-      strchr(tmpstr, '"')[0] = 0;
-    }
-
-    cnt = strlen(tmpstr);
-    if (cnt > 0)
+    if (length > 0)
     {
-      int nParamsCount = (int)cnt / 16;
+      int nParamsCount = (int)length / 16;
       PRINTF("nParamsCount = %d\n", nParamsCount);
 
       // 4 X 256 bit parameters is 16 different 64 bit parameters
@@ -487,10 +1202,8 @@ static int parse_authentication_json(const char *jsonResult,
         ui64 llParams[16];
         for (int i = 0; i < 16; i++)
         {
-          strncpy(s_tmp, &(tmpstr[i * 16]), 16);
-          s_tmp[16] = 0;
-          PRINTF("param[%d] - %s\n", i, s_tmp);
-          llParams[i] = unpack_64bit_value(s_tmp);
+          PRINTF("param[%d] - %.16s\n", i, &hex[i * 16]);
+          llParams[i] = unpack_64bit_value(&hex[i * 16]);
         }
 
         // If entity and product not found (each a 256 bit integer)
@@ -531,24 +1244,10 @@ static int parse_authentication_json(const char *jsonResult,
 
 //          puts("authentication found");
 
-          // If URI present, copy it
-          if (uri && (cnt / 16 > 24))
-          {
-            char byte[3];
-            tmpstr[cnt - 1] = '\0';
-
-            // Convert each hex nibble of result URI into string
-            for (int i = 16 * 24; i < (int)cnt; i += 2)
-            {
-              byte[0] = tmpstr[i];
-              byte[1] = tmpstr[i + 1];
-              byte[2] = '\0';
-              uri[(i - (16 * 24)) / 2] = (char)strtol(byte, NULL, 16);
-              if ((byte[0] == 0) && (byte[1] == 0))
-                break;
-            }
-          }
+          // If URI present, decode it (the fifth value is its offset)
           ret = licenseValid;
+          if (uri)
+            ret = parse_abi_string(hex, length, 4, uri, uriSize);
         }
       }
       else
@@ -590,364 +1289,6701 @@ static int parse_authentication_json(const char *jsonResult,
 }
 
 /***********************************************************************/
-/* curl_write_memory_callback: write the HTTP response to memory       */
-/*                                                                     */
-/*    Inputs: contents = the buffer in                                 */
-/*            size = the inbound buffer size                           */
-/*            nmemb = the resulting buffer current size                */
-/*    Output: userp = the user supplied MemoryStruct buffer            */
+/* json_response_reset: Reset a response before the request is sent    */
 /*                                                                     */
-/*     Returns: the new size of the resulting MemoryStruct buffer      */
+/*      Inputs: response = the response to reset                       */
 /*                                                                     */
 /***********************************************************************/
-static size_t curl_write_memory_callback(void *contents, size_t size,
-                                         size_t nmemb, void *userp)
+static void json_response_reset(JsonResponse* response)
 {
-  size_t realsize = size * nmemb;
-  char* resultBuffer = (char *)userp;
-  size_t resultSize = strlen(resultBuffer);
-
-  if(resultSize + realsize > MAX_SIZE_JSON_RESPONSE)
-  {
-    /* out of memory! */ 
-    PRINTF("not enough memory (increase MAX_SIZE_JSON_RESPONSE)\n");
-    return 0;
-  }
- 
-  memcpy(&(resultBuffer[resultSize]), contents, realsize);
-  resultBuffer[resultSize + realsize] = 0;
- 
-  return realsize;
+  response->hex.clear();
+  response->results.clear();
+  response->depth = 0;
+  response->inString = false;
+  response->escape = false;
+  response->expectKey = false;
+  response->key = jsonKeyOther;
+  response->keyLength = 0;
+  response->valueLength = 0;
+  response->batch = false;
+  response->complete = false;
+  response->body.clear();
 }
 
 /***********************************************************************/
-/* autolm_read_activation: activateStatus() contract call, parse result*/
-/*                                                                     */
-/*      Inputs: infuraId = the Infura ProductID to use                 */
-/*              jsonData = the encoded Json data for function call     */
-/*     Outputs: exp_dat = the expiration date read from the blockchain */
-/*              languages = the resulting licensed language flags      */
-/*              version_plat = the version and platform flags          */
+/* json_response_parse: Parse the next part of a JSON-RPC response     */
 /*                                                                     */
-/*       Returns: the value of any license activation returned         */
+/*      Inputs: response = the response being parsed                   */
+/*              data = the next bytes of the HTTP response body        */
+/*              length = the number of bytes                           */
+/*     Outputs: response = the id and result hex of each response      */
+/*                         object (a single object or batch array)     */
 /*                                                                     */
 /***********************************************************************/
-static int autolm_read_activation(char* infuraId, char* jsonData,
-  time_t* exp_dat, ui64* languages, ui64* version_plat)
+static void json_response_parse(JsonResponse* response, const char* data,
+                                size_t length)
 {
-  int res;
+  if (response->keepBody)
+    response->body.append(data, length);
+  for (size_t i = 0; i < length; i++)
+  {
+    char ch = data[i];
 
-  // For reading an HTML response string into memory with curl
-  char curlResponseMemory[MAX_SIZE_JSON_RESPONSE];
-  curlResponseMemory[0] = 0; // start with empty string
+    // Within a string, keep the key name, result hex or id digits
+    if (response->inString)
+    {
+      if (response->escape)
+        response->escape = false;
+      else if (ch == '\\')
+        response->escape = true;
+      else if (ch == '"')
+      {
+        response->inString = false;
+        if (response->depth != 1)
+          continue;
 
-  // Initialize curl
-  curl_global_init(CURL_GLOBAL_ALL);
+        // At the end of a key, find which value follows
+        if (response->expectKey)
+        {
+          if ((response->keyLength == 2) &&
+              (memcmp(response->keyName, "id", 2) == 0))
+            response->key = jsonKeyId;
+          else if ((response->keyLength == 6) &&
+                   (memcmp(response->keyName, "result", 6) == 0))
+            response->key = jsonKeyResult;
+          else
+            response->key = jsonKeyOther;
+        }
+        else if (response->key == jsonKeyResult)
+          response->results.back().length = response->hex.size() -
+                                     response->results.back().offset;
+      }
+      else if (response->depth != 1)
+        continue;
+      else if (response->expectKey)
+      {
+        if (response->keyLength < sizeof(response->keyName))
+          response->keyName[response->keyLength] = ch;
+        response->keyLength++;
+      }
 
-  // Easy object to handle the connection.
-  CURL* easy = curl_easy_init();
+      // Append the result hex digits, skipping the 0x
+      else if (response->key == jsonKeyResult)
+      {
+        if ((response->valueLength++ >= 2) && isxdigit((unsigned char)ch))
+          response->hex.push_back(ch);
+      }
+      else if ((response->key == jsonKeyId) && isdigit((unsigned char)ch))
+        response->results.back().id = response->results.back().id * 10 +
+                                      (ch - '0');
+      continue;
+    }
 
-  /* send all data to this function  */
-  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-    curl_write_memory_callback);
+    switch (ch)
+    {
+      case '"':
+        response->inString = true;
+        if (response->depth != 1)
+          break;
+        if (response->expectKey)
+          response->keyLength = 0;
+        else if (response->key == jsonKeyResult)
+        {
+          response->results.back().found = true;
+          response->results.back().offset = response->hex.size();
+          response->valueLength = 0;
+        }
+        break;
 
-  /* we pass our 'chunk' struct to the callback function */
-  curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void*)curlResponseMemory);
+      // A response object, or a value within it (ignore batch array)
+      case '{':
+      case '[':
+        if (response->depth == 0)
+        {
+          if (ch == '[')
+          {
+            response->batch = true;
+            break;
+          }
+          JsonResult result = { 0, false, response->hex.size(), 0 };
+          response->results.push_back(result);
+          response->expectKey = true;
+          response->key = jsonKeyOther;
+        }
+        response->depth++;
+        break;
 
-  // You can choose between 1L and 0L (enable verbose log or disable)
-#if AUTOLM_DEBUG
-  curl_easy_setopt(easy, CURLOPT_VERBOSE, 1L);
-#else
-  curl_easy_setopt(easy, CURLOPT_VERBOSE, 0L);
-#endif
-  curl_easy_setopt(easy, CURLOPT_HEADER, 1L);
-  curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L); //what ???
+      // The end of a response object, or of the batch array
+      case '}':
+      case ']':
+        if (response->depth > 0)
+          response->depth--;
+        if ((response->depth == 0) && ((ch == ']') == response->batch))
+          response->complete = true;
+        break;
+
+      case ':':
+        if (response->depth == 1)
+          response->expectKey = false;
+        break;
+
+      case ',':
+        if (response->depth == 1)
+        {
+          response->expectKey = true;
+          response->key = jsonKeyOther;
+        }
+        break;
+
+      // A numeric id
+      default:
+        if ((response->depth == 1) && !response->expectKey &&
+            (response->key == jsonKeyId) && isdigit((unsigned char)ch))
+          response->results.back().id = response->results.back().id * 10 +
+                                        (ch - '0');
+        break;
+    }
+  }
+}
+
+/***********************************************************************/
+/* json_response_result: The result hex of a parsed response object    */
+/*                                                                     */
+/*      Inputs: response = the parsed response                         */
+/*              index = the response object (zero for a single call)   */
+/*     Outputs: length = the number of result hex digits               */
+/*                                                                     */
+/*     Returns: the result hex digits (without 0x), or NULL if none    */
+/*                                                                     */
+/***********************************************************************/
+static const char* json_response_result(const JsonResponse* response,
+                                        size_t index, size_t* length)
+{
+  *length = 0;
+  if ((index >= response->results.size()) ||
+      !response->results[index].found)
+    return NULL;
+
+  *length = response->results[index].length;
+  return response->hex.data() + response->results[index].offset;
+}
+
+/***********************************************************************/
+/* curl_write_memory_callback: parse the HTTP response as it arrives   */
+/*                                                                     */
+/*    Inputs: contents = the buffer in                                 */
+/*            size = the inbound buffer size                           */
+/*            nmemb = the resulting buffer current size                */
+/*    Output: userp = the user supplied JsonResponse                   */
+/*                                                                     */
+/*     Returns: the number of bytes parsed                             */
+/*                                                                     */
+/***********************************************************************/
+static size_t curl_write_memory_callback(void *contents, size_t size,
+                                         size_t nmemb, void *userp)
+{
+  size_t realsize = size * nmemb;
+
+  json_response_parse((JsonResponse *)userp, (const char *)contents,
+                      realsize);
+  return realsize;
+}
+
+/***********************************************************************/
+/* curl_share_lock: Lock data of the share for one easy handle         */
+/*                                                                     */
+/*      Inputs: easy = the easy handle using the data                  */
+/*              data = the curl_lock_data to lock                      */
+/*              access = shared or single access (always single)       */
+/*              userptr = not used                                     */
+/*                                                                     */
+/***********************************************************************/
+static void curl_share_lock(CURL* easy, curl_lock_data data,
+                            curl_lock_access access, void* userptr)
+{
+  CurlShareLocks[data].lock();
+}
+
+/***********************************************************************/
+/* curl_share_unlock: Unlock data of the share                         */
+/*                                                                     */
+/*      Inputs: easy = the easy handle that used the data              */
+/*              data = the curl_lock_data to unlock                    */
+/*              userptr = not used                                     */
+/*                                                                     */
+/***********************************************************************/
+static void curl_share_unlock(CURL* easy, curl_lock_data data,
+                              void* userptr)
+{
+  CurlShareLocks[data].unlock();
+}
+
+/***********************************************************************/
+/* curl_global_start: One time (process) initialization of libcurl     */
+/*                                                                     */
+/*  Note: The caller must hold CurlPoolLock                            */
+/*                                                                     */
+/***********************************************************************/
+static void curl_global_start(void)
+{
+  if (!CurlInitialized)
+  {
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    // The JSON-RPC content type header is the same for every request
+    CurlJsonHeaders = curl_slist_append(NULL,
+                                        "Content-type: application/json");
+
+    // Share DNS results and TLS sessions between all handles
+    CurlShare = curl_share_init();
+    curl_share_setopt(CurlShare, CURLSHOPT_LOCKFUNC, curl_share_lock);
+    curl_share_setopt(CurlShare, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+    curl_share_setopt(CurlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(CurlShare, CURLSHOPT_SHARE,
+                      CURL_LOCK_DATA_SSL_SESSION);
+    CurlInitialized = true;
+  }
+}
+
+/***********************************************************************/
+/* deadline_remaining: Time left until the deadline of a call          */
+/*                                                                     */
+/*      Inputs: deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/*     Returns: the milliseconds left (zero once passed), or           */
+/*              ETHEREUM_TIMEOUT_MS if the call has no deadline        */
+/*                                                                     */
+/***********************************************************************/
+static long deadline_remaining(const EthereumDeadline* deadline)
+{
+  long remaining;
+
+  if (deadline == NULL)
+    return ETHEREUM_TIMEOUT_MS;
+  remaining = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline->at - std::chrono::steady_clock::now()).count();
+  return (remaining > 0) ? remaining : 0;
+}
+
+/***********************************************************************/
+/* deadline_check: Check if a call is cancelled or its deadline passed */
+/*                                                                     */
+/*      Inputs: deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/*     Returns: zero to continue, otherwise cancelled or timedOut      */
+/*                                                                     */
+/***********************************************************************/
+static int deadline_check(const EthereumDeadline* deadline)
+{
+  if (deadline == NULL)
+    return 0;
+  if ((deadline->cancel != NULL) && deadline->cancel->load())
+    return cancelled;
+  if (deadline_remaining(deadline) == 0)
+    return timedOut;
+  return 0;
+}
+
+/***********************************************************************/
+/* curl_handle_acquire: Take an easy handle for an endpoint from pool  */
+/*                                                                     */
+/*      Inputs: url = the endpoint URL the handle will connect to      */
+/*              use = the HandleUse of the handle                      */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: expired = cancelled or timedOut if the call ended      */
+/*                        waiting for a prewarmed handle, otherwise 0  */
+/*                                                                     */
+/*     Returns: a pooled (connected) or new curl easy handle, or NULL  */
+/*              (NULL to prewarm if a handle is pooled or prewarming)  */
+/*                                                                     */
+/***********************************************************************/
+static CURL* curl_handle_acquire(const char* url, int use,
+                                 const EthereumDeadline* deadline = NULL,
+                                 int* expired = NULL)
+{
+  CURL* easy = NULL;
+  std::unique_lock<std::mutex> lock(CurlPoolLock);
+
+  curl_global_start();
+  if (expired)
+    *expired = 0;
+
+  // Wait for a handle being prewarmed, it is (almost) connected, in
+  //   short intervals to notice the deadline or a cancel of the call
+  std::vector<CURL*>& idle = CurlPool[url];
+  int& prewarming = CurlPrewarming[url];
+  if ((use == handleRequest) && idle.empty() && (prewarming > 0))
+  {
+    std::chrono::steady_clock::time_point until =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(PREWARM_MAX_WAIT_MS);
+
+    PRINTF("Waiting for prewarmed curl handle for %s\n", url);
+    if (deadline && (deadline->at < until))
+      until = deadline->at;
+    while (idle.empty() && (prewarming > 0))
+    {
+      int ended = deadline_check(deadline);
+
+      if (ended)
+      {
+        if (expired)
+          *expired = ended;
+        return NULL;
+      }
+      if (std::chrono::steady_clock::now() >= until)
+        break;
+      CurlPrewarmed.wait_for(lock, std::min<std::chrono::nanoseconds>(
+        std::chrono::milliseconds(DEADLINE_POLL_MS),
+        until - std::chrono::steady_clock::now()));
+    }
+  }
+  else if (use == handlePrewarm)
+  {
+    // Already connected (or connecting), nothing to prewarm
+    if (!idle.empty() || (prewarming > 0))
+      return NULL;
+    prewarming++;
+  }
+
+  // Reuse an idle handle for this endpoint, keeping its connection
+  if (!idle.empty())
+  {
+    easy = idle.back();
+    idle.pop_back();
+    PRINTF("Reusing pooled curl handle for %s\n", url);
+  }
+  else
+    easy = curl_easy_init();
+  if ((easy == NULL) && (use == handlePrewarm))
+    prewarming--;
+  return easy;
+}
+
+/***********************************************************************/
+/* curl_handle_release: Return an easy handle to the endpoint pool     */
+/*                                                                     */
+/*      Inputs: url = the endpoint URL the handle is connected to      */
+/*              easy = the curl easy handle to return                  */
+/*                                                                     */
+/***********************************************************************/
+static void curl_handle_release(const char* url, CURL* easy)
+{
+  std::lock_guard<std::mutex> lock(CurlPoolLock);
+
+  // Reset the options but keep the live connection and DNS cache
+  curl_easy_reset(easy);
+
+  std::vector<CURL*>& idle = CurlPool[url];
+  if (idle.size() < MAX_POOLED_HANDLES)
+    idle.push_back(easy);
+  else
+    curl_easy_cleanup(easy);
+}
+
+/***********************************************************************/
+/* curl_handle_prewarmed: A prewarmed handle of an endpoint is ready   */
+/*                                                                     */
+/*      Inputs: url = the endpoint URL the handle connected to         */
+/*                                                                     */
+/*  Note: Call after returning the handle to the pool (or freeing it)  */
+/*                                                                     */
+/***********************************************************************/
+static void curl_handle_prewarmed(const char* url)
+{
+  {
+    std::lock_guard<std::mutex> lock(CurlPoolLock);
+    int& prewarming = CurlPrewarming[url];
+
+    if (prewarming > 0)
+      prewarming--;
+  }
+  CurlPrewarmed.notify_all();
+}
+
+/***********************************************************************/
+/* session_host: The host and port of the last request of a handle     */
+/*                                                                     */
+/*      Inputs: easy = the curl easy handle of the completed request   */
+/*     Outputs: key = the "host:port" of the request                   */
+/*                                                                     */
+/*     Returns: true if a host name, false if none or an IP address    */
+/*                                                                     */
+/***********************************************************************/
+static bool session_host(CURL* easy, std::string* key)
+{
+  char* url = NULL;
+  char* host = NULL;
+  char* port = NULL;
+  bool named = false;
+  CURLU* parsed = curl_url();
+
+  curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &url);
+  if (url && (curl_url_set(parsed, CURLUPART_URL, url, 0) == CURLUE_OK) &&
+      (curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK) &&
+      (curl_url_get(parsed, CURLUPART_PORT, &port,
+                    CURLU_DEFAULT_PORT) == CURLUE_OK))
+  {
+    // An IP address (or IPv6 [address]) is not resolved
+    named = (host[0] != '[') &&
+            (strspn(host, "0123456789.") != strlen(host));
+    *key = std::string(host) + ":" + port;
+  }
+  curl_free(host);
+  curl_free(port);
+  curl_url_cleanup(parsed);
+  return named;
+}
+
+#ifdef ETHEREUM_TLS_SESSIONS
+/***********************************************************************/
+/* session_export: Keep a TLS session exported from the share          */
+/*                                                                     */
+/*      Inputs: see curl_easy_ssls_export(), userptr is unused         */
+/*                                                                     */
+/*     Returns: CURLE_OK to continue the export                        */
+/*                                                                     */
+/*  Note: The caller must hold SessionLock                             */
+/*                                                                     */
+/***********************************************************************/
+static CURLcode session_export(CURL* easy, void* userptr,
+  const char* session_key, const unsigned char* shmac, size_t shmac_len,
+  const unsigned char* sdata, size_t sdata_len, curl_off_t valid_until,
+  int ietf_tls_id, const char* alpn, size_t earlydata_max)
+{
+  SessionTicket ticket;
+
+  ticket.key = session_key ? session_key : "";
+  ticket.shmac.assign((const char*)shmac, shmac ? shmac_len : 0);
+  ticket.data.assign((const char*)sdata, sdata_len);
+  ticket.validUntil = (time_t)valid_until;
+  SessionTickets.push_back(ticket);
+  return CURLE_OK;
+}
+
+/***********************************************************************/
+/* session_hex: Convert between bytes and a hex string                 */
+/*                                                                     */
+/*      Inputs: in = the bytes, or the hex string if toBytes           */
+/*              toBytes = true to convert hex to bytes                 */
+/*                                                                     */
+/*     Returns: the hex string, or the bytes if toBytes                */
+/*                                                                     */
+/***********************************************************************/
+static std::string session_hex(const std::string& in, bool toBytes)
+{
+  std::string out;
+  char hex[3];
+
+  if (toBytes)
+  {
+    for (size_t i = 0; i + 1 < in.size(); i += 2)
+    {
+      hex[0] = in[i];
+      hex[1] = in[i + 1];
+      hex[2] = 0;
+      out.push_back((char)strtoul(hex, NULL, 16));
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < in.size(); i++)
+    {
+      snprintf(hex, sizeof(hex), "%02x", (unsigned char)in[i]);
+      out.append(hex, 2);
+    }
+  }
+  return out;
+}
+#endif /* ETHEREUM_TLS_SESSIONS */
+
+/***********************************************************************/
+/* session_save: Write the host addresses and TLS sessions to the file */
+/*                                                                     */
+/*  Note: The caller must hold SessionLock                             */
+/*                                                                     */
+/***********************************************************************/
+static void session_save(void)
+{
+  std::map<std::string, SessionHost>::iterator it;
+  std::string temp = SessionFile + ".tmp";
+  time_t now = time(NULL);
+  FILE* file;
+
+  // Write a temporary file then rename it, so other processes never
+  //   read a partial file. TLS sessions are secret, owner only.
+#ifdef ETHEREUM_PRIVATE_FILES
+  char pid[16];
+  snprintf(pid, sizeof(pid), ".%d", (int)getpid());
+  temp += pid;
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+#else
+  file = fopen(temp.c_str(), "w");
+#endif
+  if (file == NULL)
+  {
+    PRINTF("Unable to write session cache file %s\n", temp.c_str());
+    return;
+  }
+
+  // Each line is "dns expires host:port address" or
+  //   "tls validUntil key shmac data" (hex, - if empty)
+  for (it = SessionHosts.begin(); it != SessionHosts.end(); ++it)
+    if (it->second.expires > now)
+      fprintf(file, "dns %lld %s %s\n", (long long)it->second.expires,
+              it->first.c_str(), it->second.address.c_str());
+#ifdef ETHEREUM_TLS_SESSIONS
+  for (size_t i = 0; i < SessionTickets.size(); i++)
+  {
+    SessionTicket& ticket = SessionTickets[i];
+
+    if (ticket.validUntil <= now)
+      continue;
+    fprintf(file, "tls %lld %s %s %s\n", (long long)ticket.validUntil,
+            ticket.key.empty() ? "-" : session_hex(ticket.key,
+                                                   false).c_str(),
+            ticket.shmac.empty() ? "-" : session_hex(ticket.shmac,
+                                                     false).c_str(),
+            session_hex(ticket.data, false).c_str());
+  }
+#endif
+  fclose(file);
+
+#ifndef ETHEREUM_PRIVATE_FILES
+  remove(SessionFile.c_str());
+#endif
+  if (rename(temp.c_str(), SessionFile.c_str()) != 0)
+    remove(temp.c_str());
+}
+
+/***********************************************************************/
+/* session_load: Read the host addresses and TLS sessions of the file  */
+/*                                                                     */
+/*  Note: The caller must hold SessionLock                             */
+/*                                                                     */
+/***********************************************************************/
+static void session_load(void)
+{
+  time_t now = time(NULL);
+  std::string contents;
+  char buf[IPC_READ_SIZE];
+  size_t count, start, end;
+  FILE* file;
+
+  file = fopen(SessionFile.c_str(), "r");
+  if (file == NULL)
+    return;
+  while ((count = fread(buf, 1, sizeof(buf), file)) > 0)
+    contents.append(buf, count);
+  fclose(file);
+
+#ifdef ETHEREUM_TLS_SESSIONS
+  // TLS sessions are imported into the share through a handle
+  CURL* easy = curl_easy_init();
+  curl_easy_setopt(easy, CURLOPT_SHARE, CurlShare);
+#endif
+
+  // Parse each line, skipping anything expired
+  for (start = 0; start < contents.size(); start = end + 1)
+  {
+    char type[4], key[MAX_SIZE_URL], address[64];
+    long long expires;
+
+    end = contents.find('\n', start);
+    if (end == std::string::npos)
+      end = contents.size();
+    std::string line = contents.substr(start, end - start);
+
+    if ((sscanf(line.c_str(), "%3s %lld", type, &expires) != 2) ||
+        (expires <= now))
+      continue;
+
+    if ((strcmp(type, "dns") == 0) &&
+        (sscanf(line.c_str(), "%*s %*s %319s %63s", key, address) == 2))
+    {
+      SessionHost host = { address, (time_t)expires };
+      std::string entry;
+
+      SessionHosts[key] = host;
+
+      // A "+" entry expires from the DNS cache like a resolved one
+      entry = std::string("+") + key + ":" +
+              (strchr(address, ':') ? "[" + std::string(address) + "]" :
+                                      std::string(address));
+      SessionResolve = curl_slist_append(SessionResolve, entry.c_str());
+      if ((SessionResolveExpires == 0) ||
+          (expires < SessionResolveExpires))
+        SessionResolveExpires = (time_t)expires;
+    }
+#ifdef ETHEREUM_TLS_SESSIONS
+    else if (strcmp(type, "tls") == 0)
+    {
+      size_t field[3], spaces = 0, at = 0;
+
+      // The key, shmac and data hex fields follow type and time
+      for (size_t i = 0; (i < line.size()) && (at < 3); i++)
+        if ((line[i] == ' ') && (++spaces >= 2))
+          field[at++] = i + 1;
+      if (at != 3)
+        continue;
+
+      SessionTicket ticket;
+      std::string hexKey = line.substr(field[0], field[1] - field[0] - 1);
+      std::string hexMac = line.substr(field[1], field[2] - field[1] - 1);
+
+      ticket.key = (hexKey == "-") ? "" : session_hex(hexKey, true);
+      ticket.shmac = (hexMac == "-") ? "" : session_hex(hexMac, true);
+      ticket.data = session_hex(line.substr(field[2]), true);
+      ticket.validUntil = (time_t)expires;
+      if (curl_easy_ssls_import(easy,
+            ticket.key.empty() ? NULL : ticket.key.c_str(),
+            (const unsigned char*)ticket.shmac.data(), ticket.shmac.size(),
+            (const unsigned char*)ticket.data.data(),
+            ticket.data.size()) == CURLE_OK)
+        SessionTickets.push_back(ticket);
+    }
+#endif
+  }
+
+#ifdef ETHEREUM_TLS_SESSIONS
+  curl_easy_cleanup(easy);
+#endif
+}
+
+/***********************************************************************/
+/* session_resolve: Use the cached host addresses instead of DNS       */
+/*                                                                     */
+/*      Inputs: easy = the curl easy handle of the request             */
+/*                                                                     */
+/***********************************************************************/
+static void session_resolve(CURL* easy)
+{
+  std::lock_guard<std::mutex> lock(SessionLock);
+
+  if (SessionRemove)
+  {
+    curl_easy_setopt(easy, CURLOPT_RESOLVE, SessionRemove);
+    SessionRetired.push_back(SessionRemove);
+    SessionRemove = NULL;
+  }
+  else if (SessionResolve && (time(NULL) < SessionResolveExpires))
+    curl_easy_setopt(easy, CURLOPT_RESOLVE, SessionResolve);
+}
+
+/***********************************************************************/
+/* session_free: Free the cached address lists of the DNS cache        */
+/*                                                                     */
+/*  Note: The caller must hold SessionLock, no request may be running  */
+/*                                                                     */
+/***********************************************************************/
+static void session_free(void)
+{
+  curl_slist_free_all(SessionResolve);
+  SessionResolve = NULL;
+  SessionResolveExpires = 0;
+  curl_slist_free_all(SessionRemove);
+  SessionRemove = NULL;
+  for (size_t i = 0; i < SessionRetired.size(); i++)
+    curl_slist_free_all(SessionRetired[i]);
+  SessionRetired.clear();
+}
+
+/***********************************************************************/
+/* session_update: Cache the address and TLS session of a new          */
+/*                 connection, or forget the address if it failed      */
+/*                                                                     */
+/*      Inputs: easy = the curl easy handle of the completed request   */
+/*              connected = true if the request succeeded              */
+/*                                                                     */
+/***********************************************************************/
+static void session_update(CURL* easy, bool connected)
+{
+  std::lock_guard<std::mutex> lock(SessionLock);
+  std::string key;
+  long connects = 0;
+  char* ip = NULL;
+
+  if (SessionFile.empty())
+    return;
+
+  // A cached address that fails is resolved again (DNS) from now on
+  if (!connected)
+  {
+    if (session_host(easy, &key) && SessionHosts.erase(key))
+    {
+      SessionResolveExpires = 0;
+      SessionRemove = curl_slist_append(SessionRemove,
+                                        ("-" + key).c_str());
+      session_save();
+    }
+    return;
+  }
+
+  // Nothing new to cache if the request reused a connection
+  curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+  if (connects == 0)
+    return;
+
+  curl_easy_getinfo(easy, CURLINFO_PRIMARY_IP, &ip);
+  if (session_host(easy, &key) && ip && ip[0])
+  {
+    SessionHost host = { ip, time(NULL) + SESSION_DNS_TTL_SECONDS };
+    SessionHosts[key] = host;
+  }
+
+#ifdef ETHEREUM_TLS_SESSIONS
+  // The share has the TLS sessions of every host, export them all
+  SessionTickets.clear();
+  curl_easy_ssls_export(easy, session_export, NULL);
+#endif
+  session_save();
+}
+
+/***********************************************************************/
+/* deadline_sleep: Wait, unless the call is cancelled                  */
+/*                                                                     */
+/*      Inputs: deadline = the deadline of the call, NULL for none     */
+/*              msec = the time to wait, in milliseconds               */
+/*                                                                     */
+/*     Returns: zero after the wait, otherwise cancelled or timedOut   */
+/*                                                                     */
+/***********************************************************************/
+static int deadline_sleep(const EthereumDeadline* deadline, double msec)
+{
+  std::chrono::steady_clock::time_point end =
+    std::chrono::steady_clock::now() +
+    std::chrono::microseconds((long long)(msec * 1000));
+
+  // Wait in short intervals to notice a cancel of the call
+  while (std::chrono::steady_clock::now() < end)
+  {
+    int expired = deadline_check(deadline);
+    if (expired)
+      return expired;
+    if ((deadline != NULL) && (deadline->cancel != NULL))
+      std::this_thread::sleep_until(std::min(end,
+        std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(DEADLINE_POLL_MS)));
+    else
+      std::this_thread::sleep_until(end);
+  }
+  return deadline_check(deadline);
+}
+
+/***********************************************************************/
+/* random_jitter: A random part of a wait, so that callers (and other  */
+/*                processes) waiting after the same failure spread out */
+/*                                                                     */
+/*      Inputs: msec = the most jitter, in milliseconds                */
+/*                                                                     */
+/*     Returns: a uniformly random jitter from zero to msec            */
+/*                                                                     */
+/***********************************************************************/
+static double random_jitter(double msec)
+{
+  std::lock_guard<std::mutex> lock(JitterLock);
+
+  return std::uniform_real_distribution<double>(0, msec)(JitterRandom);
+}
+
+/***********************************************************************/
+/* curl_cancel_callback: Abort a transfer when the call is cancelled   */
+/*                                                                     */
+/*      Inputs: clientp = the cancel flag of the call                  */
+/*                                                                     */
+/*     Returns: zero to continue, otherwise abort the transfer         */
+/*                                                                     */
+/***********************************************************************/
+static int curl_cancel_callback(void* clientp, curl_off_t dltotal,
+                                curl_off_t dlnow, curl_off_t ultotal,
+                                curl_off_t ulnow)
+{
+  return ((const std::atomic<bool>*)clientp)->load() ? 1 : 0;
+}
+
+/***********************************************************************/
+/* curl_setup_post: Set the options of a JSON-RPC HTTP POST request    */
+/*                                                                     */
+/*      Inputs: easy = the curl easy handle of the request             */
+/*              url = the full endpoint URL to post to                 */
+/*              jsonData = the encoded Json data for function call     */
+/*              response = the response to parse as it arrives         */
+/*              deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/***********************************************************************/
+static void curl_setup_post(CURL* easy, const char* url,
+                            const char* jsonData, JsonResponse* response,
+                            const EthereumDeadline* deadline)
+{
+  long timeout = std::max(deadline_remaining(deadline), 1L);
+
+  // Start with an empty response
+  json_response_reset(response);
+
+  /* send all data to this function  */
+  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+                   curl_write_memory_callback);
+
+  /* we pass our 'chunk' struct to the callback function */
+  curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void*)response);
+
+  // You can choose between 1L and 0L (enable verbose log or disable)
+#if AUTOLM_DEBUG
+  curl_easy_setopt(easy, CURLOPT_VERBOSE, 1L);
+#else
+  curl_easy_setopt(easy, CURLOPT_VERBOSE, 0L);
+#endif
+  curl_easy_setopt(easy, CURLOPT_HEADER, 0L); // body only, to parse
+  curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+
+  // Keep the connection alive between calls, it is pooled for reuse
+  curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+
+  // The request ends by the deadline, and a slow connect (DNS, TCP and
+  //   TLS) ends early enough to fail over to another endpoint
+  curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, timeout);
+  curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                   std::max(timeout * DEADLINE_CONNECT_PERCENT / 100, 1L));
+  if ((deadline != NULL) && (deadline->cancel != NULL))
+  {
+    curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION,
+                     curl_cancel_callback);
+    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, (void*)deadline->cancel);
+    curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+  }
 
-  // Let's create an object which will contain a list of headers.
   PRINTF("jsonData = %s\n", jsonData);
   PRINTF("strlen (jsonData) = %d\n", (int)strlen(jsonData));
 
-#ifdef _WINDOWS
-#ifdef _OPENSSL
-  // Point curl to a root certificate store (file required)
-  curl_easy_setopt(easy, CURLOPT_CAINFO, "./cacert.pem");
-#endif
+#ifdef _WINDOWS
+#ifdef _OPENSSL
+  // Point curl to a root certificate store (file required)
+  curl_easy_setopt(easy, CURLOPT_CAINFO, "./cacert.pem");
+#endif
+#endif
+
+  /* Post json data */
+  curl_easy_setopt(easy, CURLOPT_POSTFIELDS, jsonData);
+  unsigned int jsonDataLength = (int)strlen(jsonData);
+  PRINTF("CURLOPT_POSTFIELDSIZE set to jsonDataLength = %d\n",
+         jsonDataLength);
+  /* set the size of the postfields data */
+  curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, jsonDataLength);
+
+  // Add the application/json content type header to the easy object.
+  curl_easy_setopt(easy, CURLOPT_HTTPHEADER, CurlJsonHeaders);
+
+  PRINTF("URL = %s\n", url);
+  curl_easy_setopt(easy, CURLOPT_URL, url);
+
+  // Share DNS results and TLS sessions with every handle, and use the
+  //   host addresses cached by the last process
+  curl_easy_setopt(easy, CURLOPT_SHARE, CurlShare);
+  session_resolve(easy);
+}
+
+/***********************************************************************/
+/* curl_result: Check the result of a completed HTTP request           */
+/*                                                                     */
+/*      Inputs: easy = the curl easy handle of the completed request   */
+/*              code = the curl result of the request                  */
+/*     Outputs: msec = the total time of the request, in milliseconds  */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, requestRejected*/
+/*              if retrying cannot succeed, otherwise curlPerformFailed*/
+/*                                                                     */
+/***********************************************************************/
+static int curl_result(CURL* easy, CURLcode code, double* msec)
+{
+  double seconds = 0;
+  long status = 0;
+
+  curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &seconds);
+  *msec = seconds * 1000;
+  if (code != CURLE_OK)
+  {
+    PRINTF("Error performing curl request: %s\n", curl_easy_strerror(code));
+    if (code == CURLE_ABORTED_BY_CALLBACK)
+      return cancelled;
+    session_update(easy, false);
+    if (code == CURLE_OPERATION_TIMEDOUT)
+      return timedOut;
+
+    // A bad URL or certificate fails the same way every time
+    if ((code == CURLE_UNSUPPORTED_PROTOCOL) ||
+        (code == CURLE_URL_MALFORMAT) ||
+        (code == CURLE_PEER_FAILED_VERIFICATION) ||
+        (code == CURLE_SSL_CERTPROBLEM) ||
+        (code == CURLE_SSL_CACERT_BADFILE))
+      return requestRejected;
+    return curlPerformFailed;
+  }
+  session_update(easy, true);
+
+  // An HTTP error (rate limit, server error) is an endpoint failure,
+  //   and a client error (bad URL or provider Id) is not retried
+  curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+  if (status >= 400)
+  {
+    PRINTF("Endpoint returned HTTP status %ld\n", status);
+    if ((status < 500) && (status != 408) && (status != 425) &&
+        (status != 429))
+      return requestRejected;
+    return curlPerformFailed;
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* curl_post_json: HTTP POST JSON-RPC request on a pooled connection   */
+/*                                                                     */
+/*      Inputs: url = the full endpoint URL to post to                 */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the resulting HTTP response                 */
+/*              msec = the total time of the request, in milliseconds  */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, otherwise      */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int curl_post_json(const char* url, const char* jsonData,
+                          JsonResponse* response, double* msec,
+                          const EthereumDeadline* deadline)
+{
+  int res;
+
+  // Easy object to handle the connection, reused from the pool
+  CURL* easy = curl_handle_acquire(url, handleRequest, deadline, &res);
+  if (easy == NULL)
+    return res ? res : curlPerformFailed;
+
+  curl_setup_post(easy, url, jsonData, response, deadline);
+
+  // Perform the HTTP request
+  res = curl_result(easy, curl_easy_perform(easy), msec);
+
+  // Return the easy handle (and connection) to the pool for next call
+  curl_handle_release(url, easy);
+  return res;
+}
+
+/***********************************************************************/
+/* endpoint_is_ipc: Check if an endpoint URL is a local IPC socket     */
+/*                                                                     */
+/*      Inputs: url = the endpoint URL                                 */
+/*                                                                     */
+/*     Returns: true if the URL is ipc://<socket path>                 */
+/*                                                                     */
+/***********************************************************************/
+static bool endpoint_is_ipc(const char* url)
+{
+  return strncmp(url, IPC_URL_PREFIX, strlen(IPC_URL_PREFIX)) == 0;
+}
+
+#ifdef ETHEREUM_IPC
+/***********************************************************************/
+/* ipc_socket_acquire: Take a connected socket for a path from pool    */
+/*                                                                     */
+/*      Inputs: path = the Unix domain socket path of the node         */
+/*     Outputs: pooled = true if the socket was reused from the pool   */
+/*                                                                     */
+/*     Returns: the connected socket, or -1 if the connect failed      */
+/*                                                                     */
+/***********************************************************************/
+static int ipc_socket_acquire(const char* path, bool* pooled)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  // Reuse an idle connection to this node
+  {
+    std::lock_guard<std::mutex> lock(IpcPoolLock);
+    std::vector<int>& idle = IpcPool[path];
+
+    *pooled = !idle.empty();
+    if (*pooled)
+    {
+      fd = idle.back();
+      idle.pop_back();
+      return fd;
+    }
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    PRINTF("Connect to IPC socket %s failed\n", path);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/***********************************************************************/
+/* ipc_socket_release: Return a connected socket to the path pool      */
+/*                                                                     */
+/*      Inputs: path = the Unix domain socket path of the node         */
+/*              fd = the socket to return                              */
+/*                                                                     */
+/***********************************************************************/
+static void ipc_socket_release(const char* path, int fd)
+{
+  std::lock_guard<std::mutex> lock(IpcPoolLock);
+  std::vector<int>& idle = IpcPool[path];
+
+  if (idle.size() < MAX_POOLED_HANDLES)
+    idle.push_back(fd);
+  else
+    close(fd);
+}
+
+/***********************************************************************/
+/* ipc_exchange: Send a JSON-RPC request and parse the response        */
+/*                                                                     */
+/*      Inputs: fd = the socket connected to the node                  */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the parsed response                         */
+/*              received = true if any response bytes were read        */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, otherwise      */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int ipc_exchange(int fd, const char* jsonData,
+                        JsonResponse* response, bool* received,
+                        const EthereumDeadline* deadline)
+{
+  std::chrono::steady_clock::time_point end = (deadline != NULL) ?
+    deadline->at : std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(IPC_TIMEOUT_MS);
+  size_t length = strlen(jsonData), sent = 0;
+  char buf[IPC_READ_SIZE];
+
+  *received = false;
+  while (sent < length)
+  {
+    ssize_t count = send(fd, jsonData + sent, length - sent,
+                         MSG_NOSIGNAL);
+    if (count <= 0)
+      return curlPerformFailed;
+    sent += count;
+  }
+
+  // Parse the response as it arrives, until the whole object or array
+  while (!response->complete)
+  {
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    int remaining = (int)
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+        end - std::chrono::steady_clock::now()).count();
+    int ready;
+
+    if ((deadline != NULL) && (deadline->cancel != NULL))
+    {
+      if (deadline->cancel->load())
+        return cancelled;
+      remaining = std::min(remaining, DEADLINE_POLL_MS);
+    }
+    if (remaining <= 0)
+    {
+      PRINTF("IPC response timed out\n");
+      return timedOut;
+    }
+
+    // Wait in short intervals to notice a cancel of the call
+    ready = poll(&pfd, 1, remaining);
+    if (ready < 0)
+      return curlPerformFailed;
+    if (ready == 0)
+      continue;
+
+    ssize_t count = recv(fd, buf, sizeof(buf), 0);
+    if (count <= 0)
+      return curlPerformFailed;
+    *received = true;
+    json_response_parse(response, buf, count);
+  }
+  return 0;
+}
+#endif /* ETHEREUM_IPC */
+
+/***********************************************************************/
+/* ipc_post_json: JSON-RPC request to a local node over IPC socket     */
+/*                                                                     */
+/*      Inputs: url = the endpoint URL, ipc://<socket path>            */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the parsed response                         */
+/*              msec = the total time of the request, in milliseconds  */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, otherwise      */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int ipc_post_json(const char* url, const char* jsonData,
+                         JsonResponse* response, double* msec,
+                         const EthereumDeadline* deadline)
+{
+  int res = curlPerformFailed;
+
+  *msec = 0;
+#ifdef ETHEREUM_IPC
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  const char* path = url + strlen(IPC_URL_PREFIX);
+
+  // A pooled connection the node has since closed fails before any
+  //   response, so it is retried once on a new connection
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    bool pooled, received;
+    int fd = ipc_socket_acquire(path, &pooled);
+
+    if (fd < 0)
+      break;
+    json_response_reset(response);
+    res = ipc_exchange(fd, jsonData, response, &received, deadline);
+    if (res == 0)
+    {
+      ipc_socket_release(path, fd);
+      break;
+    }
+    close(fd);
+    if (!pooled || received || (res != curlPerformFailed))
+      break;
+  }
+  *msec = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+#else
+  // Named pipes are not supported, use an HTTP endpoint of the node
+  PRINTF("IPC endpoint %s not supported on this platform\n", url);
+#endif
+  return res;
+}
+
+/***********************************************************************/
+/* ethereum_send_json: JSON-RPC request to an endpoint URL             */
+/*                                                                     */
+/*      Inputs: url = the full endpoint URL, HTTP(S) or IPC            */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the parsed response                         */
+/*              msec = the total time of the request, in milliseconds  */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, otherwise      */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int ethereum_send_json(const char* url, const char* jsonData,
+                              JsonResponse* response, double* msec,
+                              const EthereumDeadline* deadline)
+{
+  if (endpoint_is_ipc(url))
+    return ipc_post_json(url, jsonData, response, msec, deadline);
+  return curl_post_json(url, jsonData, response, msec, deadline);
+}
+
+/***********************************************************************/
+/* endpoint_create: Create a JSON-RPC endpoint of the provider pool    */
+/*                                                                     */
+/*      Inputs: url = the base URL of the endpoint                     */
+/*              appendId = true to append the provider Id to the URL   */
+/*                                                                     */
+/*     Returns: the new endpoint, healthy with no latency measured     */
+/*                                                                     */
+/***********************************************************************/
+static std::shared_ptr<EthereumEndpoint> endpoint_create(const char* url,
+                                                         bool appendId)
+{
+  std::shared_ptr<EthereumEndpoint> endpoint =
+    std::make_shared<EthereumEndpoint>();
+
+  endpoint->url = url;
+  endpoint->appendId = appendId;
+  endpoint->healthy = true;
+  endpoint->failed = 0;
+  endpoint->failures = 0;
+  endpoint->trips = 0;
+  endpoint->reopen = 0;
+  endpoint->latency = 0;
+  endpoint->requests = 0;
+  endpoint->rate = 0;
+  endpoint->burst = 0;
+  endpoint->tokens = 0;
+  endpoint->quota = 0;
+  return endpoint;
+}
+
+/***********************************************************************/
+/* endpoint_default: Add CURL_HOST_URL if the provider pool is empty   */
+/*                                                                     */
+/*  Note: The caller must hold EndpointLock                            */
+/*                                                                     */
+/***********************************************************************/
+static void endpoint_default(void)
+{
+  if (Endpoints.empty())
+  {
+    // Only Infura URLs end with the project (provider) Id
+    Endpoints.push_back(endpoint_create(CURL_HOST_URL,
+                           strstr(CURL_HOST_URL, "infura.io") != NULL));
+  }
+}
+
+/***********************************************************************/
+/* quota_count: The requests sent to an endpoint today                 */
+/*                                                                     */
+/*      Inputs: url = the base URL of the endpoint                     */
+/*                                                                     */
+/*     Returns: the count of today, reset at the start of each day     */
+/*                                                                     */
+/*  Note: The caller must hold EndpointLock                            */
+/*                                                                     */
+/***********************************************************************/
+static QuotaCount& quota_count(const std::string& url)
+{
+  int today = (int)(time(NULL) / SECONDS_PER_DAY);
+  QuotaCount& count = QuotaUsage[url];
+
+  if (count.day != today)
+  {
+    count.day = today;
+    count.used = 0;
+  }
+  return count;
+}
+
+/***********************************************************************/
+/* quota_sync: Count a request in the quota file, and read the counts  */
+/*             of every process of the host from it                    */
+/*                                                                     */
+/*      Inputs: url = the base URL of the endpoint of the request, or  */
+/*                    NULL to only read the counts                     */
+/*                                                                     */
+/*  Note: The file is locked (advisory) while read and written, and is */
+/*        replaced by a rename so a reader never sees a partial file.  */
+/*        The caller must not hold EndpointLock.                       */
+/*                                                                     */
+/***********************************************************************/
+static void quota_sync(const char* url)
+{
+  int today = (int)(time(NULL) / SECONDS_PER_DAY);
+  std::map<std::string, QuotaCount> counts;
+  std::map<std::string, QuotaCount>::iterator it;
+  std::string filename, temp;
+  char line[MAX_SIZE_URL];
+  QuotaCount count;
+  FILE* file;
+  std::lock_guard<std::mutex> lock(QuotaLock);
+
+  {
+    std::lock_guard<std::mutex> endpointLock(EndpointLock);
+    filename = QuotaFile;
+  }
+  if (filename.empty())
+    return;
+
+  // Only one process reads and writes the file at a time
+#ifdef ETHEREUM_PRIVATE_FILES
+  int fd = open((filename + ".lock").c_str(), O_RDWR | O_CREAT, 0600);
+  if ((fd >= 0) && (flock(fd, LOCK_EX) != 0))
+  {
+    close(fd);
+    fd = -1;
+  }
+  if (fd < 0)
+#elif defined(_WINDOWS)
+  OVERLAPPED overlapped;
+  HANDLE handle = CreateFileA((filename + ".lock").c_str(),
+                              GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+  memset(&overlapped, 0, sizeof(overlapped));
+  if ((handle != INVALID_HANDLE_VALUE) &&
+      !LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped))
+  {
+    CloseHandle(handle);
+    handle = INVALID_HANDLE_VALUE;
+  }
+  if (handle == INVALID_HANDLE_VALUE)
+#else
+  if (false)
+#endif
+  {
+    PRINTF("Unable to lock quota file %s\n", filename.c_str());
+    return;
+  }
+
+  // Each line is "day used url", counts of earlier days are dropped
+  file = fopen(filename.c_str(), "r");
+  if (file != NULL)
+  {
+    while (fscanf(file, "%d %u %255s", &count.day, &count.used, line) == 3)
+      if (count.day == today)
+        counts[line] = count;
+    fclose(file);
+  }
+
+  // Add the request, then replace the file with the new counts
+  if (url != NULL)
+  {
+    QuotaCount& used = counts[url];
+
+    if (used.day != today)
+    {
+      used.day = today;
+      used.used = 0;
+    }
+    used.used++;
+    temp = filename + ".tmp";
+    file = fopen(temp.c_str(), "w");
+    if (file != NULL)
+    {
+      for (it = counts.begin(); it != counts.end(); ++it)
+        fprintf(file, "%d %u %s\n", it->second.day, it->second.used,
+                it->first.c_str());
+      fclose(file);
+#ifdef _WINDOWS
+      remove(filename.c_str());
+#endif
+      if (rename(temp.c_str(), filename.c_str()) != 0)
+        remove(temp.c_str());
+    }
+    else
+      PRINTF("Unable to write quota file %s\n", filename.c_str());
+  }
+
+#ifdef ETHEREUM_PRIVATE_FILES
+  flock(fd, LOCK_UN);
+  close(fd);
+#elif defined(_WINDOWS)
+  UnlockFileEx(handle, 0, 1, 0, &overlapped);
+  CloseHandle(handle);
+#endif
+
+  // The counts of this process include requests not yet in the file
+  std::lock_guard<std::mutex> endpointLock(EndpointLock);
+  for (it = counts.begin(); it != counts.end(); ++it)
+  {
+    QuotaCount& used = quota_count(it->first);
+
+    used.used = std::max(used.used, it->second.used);
+  }
+}
+
+/***********************************************************************/
+/* endpoint_admit: Admit a request to an endpoint, if within limits    */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint of the provider pool           */
+/*              priority = the RequestPriority of the request          */
+/*     Outputs: waitMs = lowered to the wait for a token, if limited   */
+/*                                                                     */
+/*     Returns: true if admitted (token used and request counted)      */
+/*                                                                     */
+/*  Note: The caller must hold EndpointLock, and call quota_sync()     */
+/*        after releasing it if the endpoint has a daily quota         */
+/*                                                                     */
+/***********************************************************************/
+static bool endpoint_admit(EthereumEndpoint* endpoint, int priority,
+                           double* waitMs)
+{
+  // Refuse when the daily quota is spent, or low priority when low
+  if (endpoint->quota)
+  {
+    ui32 used = quota_count(endpoint->url).used;
+    ui32 remaining = (used < endpoint->quota) ? endpoint->quota - used : 0;
+
+    if ((remaining == 0) || ((priority == priorityLow) &&
+        (remaining * 100.0 < endpoint->quota * QUOTA_RESERVE_PERCENT)))
+      return false;
+  }
+
+  // Refill the token bucket for the time since the last request
+  if (endpoint->rate > 0)
+  {
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+
+    endpoint->tokens = std::min(endpoint->burst, endpoint->tokens +
+                        endpoint->rate * std::chrono::duration<double>(
+                          now - endpoint->refilled).count());
+    endpoint->refilled = now;
+    if (endpoint->tokens < 1)
+    {
+      double wait = (1 - endpoint->tokens) * 1000 / endpoint->rate;
+      if ((*waitMs < 0) || (wait < *waitMs))
+        *waitMs = wait;
+      return false;
+    }
+    endpoint->tokens -= 1;
+  }
+
+  // Count the request, the caller persists it for other processes
+  if (endpoint->quota)
+    quota_count(endpoint->url).used++;
+  return true;
+}
+
+/***********************************************************************/
+/* endpoint_choose: Choose the endpoint for the next request attempt   */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              tried = the endpoints that already failed this request */
+/*              priority = the RequestPriority of the request          */
+/*     Outputs: limited = true if an endpoint was refused by a limit   */
+/*              waitMs = the wait for a rate limit token, or -1        */
+/*              open = true if an endpoint was skipped, its circuit    */
+/*                     breaker open                                    */
+/*              counted = true if counted against a daily quota        */
+/*                                                                     */
+/*     Returns: the fastest healthy endpoint not tried, otherwise the  */
+/*              endpoint that failed longest ago, or NULL if all tried */
+/*              or refused by the rate limit, daily quota or breaker   */
+/*                                                                     */
+/***********************************************************************/
+static std::shared_ptr<EthereumEndpoint> endpoint_choose(
+  const EthereumNetwork* network,
+  const std::vector<EthereumEndpoint*>& tried, int priority,
+  bool* limited, double* waitMs, bool* open, bool* counted)
+{
+  std::vector<std::shared_ptr<EthereumEndpoint> > candidates;
+  time_t now = time(NULL);
+  std::lock_guard<std::mutex> lock(EndpointLock);
+
+  *limited = false;
+  *waitMs = -1;
+  *open = false;
+  *counted = false;
+
+  // A network with a url uses only that endpoint, not the pool
+  if (network && network->url[0])
+  {
+    std::shared_ptr<EthereumEndpoint>& endpoint =
+      NetworkEndpoints[network->url];
+
+    if (endpoint == NULL)
+      endpoint = endpoint_create(network->url, network->appendId);
+    endpoint->appendId = network->appendId;
+    if (tried.empty())
+      candidates.push_back(endpoint);
+  }
+  else
+  {
+    endpoint_default();
+    for (size_t i = 0; i < Endpoints.size(); i++)
+      if (std::find(tried.begin(), tried.end(), Endpoints[i].get()) ==
+          tried.end())
+        candidates.push_back(Endpoints[i]);
+  }
+
+  // Prefer usable endpoints by latency, in pool order if equal. A
+  //   failed endpoint is usable again after ENDPOINT_RECHECK_SECONDS
+  std::stable_sort(candidates.begin(), candidates.end(),
+    [now](const std::shared_ptr<EthereumEndpoint>& a,
+          const std::shared_ptr<EthereumEndpoint>& b)
+    {
+      bool aUsable = a->healthy ||
+                     (now - a->failed >= ENDPOINT_RECHECK_SECONDS);
+      bool bUsable = b->healthy ||
+                     (now - b->failed >= ENDPOINT_RECHECK_SECONDS);
+
+      if (aUsable != bUsable)
+        return aUsable;
+      return aUsable ? (a->latency < b->latency) : (a->failed < b->failed);
+    });
+
+  // The first preferred endpoint within its limits
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    EthereumEndpoint* endpoint = candidates[i].get();
+    bool broken = (endpoint->failures >= ENDPOINT_BREAKER_FAILURES);
+
+    // An open circuit breaker fails fast until the time to probe
+    if (broken && (now < endpoint->reopen))
+    {
+      *open = true;
+      continue;
+    }
+    if (endpoint_admit(endpoint, priority, waitMs))
+    {
+      // Only this request probes, until it completes
+      if (broken)
+        endpoint->reopen = now + ENDPOINT_RECHECK_SECONDS;
+      *counted = (endpoint->quota != 0);
+      return candidates[i];
+    }
+    *limited = true;
+  }
+  return NULL;
+}
+
+/***********************************************************************/
+/* endpoint_select: Select the endpoint for the next request attempt   */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              tried = the endpoints that already failed this request */
+/*              priority = the RequestPriority of the request          */
+/*     Outputs: limited = true if an endpoint was refused by a limit   */
+/*              waitMs = the wait for a rate limit token, or -1        */
+/*              open = true if an endpoint was skipped, its circuit    */
+/*                     breaker open                                    */
+/*                                                                     */
+/*     Returns: the endpoint, see endpoint_choose(), or NULL           */
+/*                                                                     */
+/***********************************************************************/
+static std::shared_ptr<EthereumEndpoint> endpoint_select(
+  const EthereumNetwork* network,
+  const std::vector<EthereumEndpoint*>& tried, int priority,
+  bool* limited, double* waitMs, bool* open)
+{
+  std::shared_ptr<EthereumEndpoint> endpoint;
+  bool counted;
+
+  endpoint = endpoint_choose(network, tried, priority, limited, waitMs,
+                             open, &counted);
+
+  // Persist the count for other processes, without EndpointLock
+  if (counted)
+    quota_sync(endpoint->url.c_str());
+  return endpoint;
+}
+
+/***********************************************************************/
+/* endpoint_url: Create the full request URL of an endpoint            */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint of the provider pool           */
+/*              infuraId = the provider (Infura) Id to use             */
+/*      Output: urlBuf = the resulting URL (MAX_SIZE_URL bytes)        */
+/*                                                                     */
+/***********************************************************************/
+static void endpoint_url(const EthereumEndpoint* endpoint,
+                         const char* infuraId, char* urlBuf)
+{
+  if (endpoint->appendId && infuraId)
+    snprintf(urlBuf, MAX_SIZE_URL, "%s%s", endpoint->url.c_str(),
+             infuraId);
+  else
+    snprintf(urlBuf, MAX_SIZE_URL, "%s", endpoint->url.c_str());
+}
+
+/***********************************************************************/
+/* endpoint_update: Update endpoint health and latency after a request */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint the request was sent to        */
+/*              res = zero if the request succeeded                    */
+/*              msec = the total time of the request, in milliseconds  */
+/*                                                                     */
+/*  Note: ENDPOINT_BREAKER_FAILURES transient failures in a row open   */
+/*        the circuit breaker of the endpoint. It is then skipped for  */
+/*        ENDPOINT_RECHECK_SECONDS (doubled after each failed probe,   */
+/*        plus jitter) before one request probes it again.             */
+/*                                                                     */
+/***********************************************************************/
+static void endpoint_update(EthereumEndpoint* endpoint, int res,
+                            double msec)
+{
+  std::lock_guard<std::mutex> lock(EndpointLock);
+
+  // A request cancelled by the caller says nothing of the endpoint
+  if (res == cancelled)
+    return;
+
+  if (res == 0)
+  {
+    // Keep the latest latencies for the percentile hedge delay
+    endpoint->samples[endpoint->requests % ENDPOINT_LATENCY_SAMPLES] =
+      msec;
+
+    // Exponentially weighted moving average, first sample as is
+    if (endpoint->requests++ == 0)
+      endpoint->latency = msec;
+    else
+      endpoint->latency = (ENDPOINT_EWMA_WEIGHT * msec) +
+                          ((1 - ENDPOINT_EWMA_WEIGHT) * endpoint->latency);
+    endpoint->healthy = true;
+    endpoint->failures = 0;
+    endpoint->trips = 0;
+  }
+  else
+  {
+    PRINTF("Endpoint %s failed, failing over\n", endpoint->url.c_str());
+    endpoint->healthy = false;
+    endpoint->failed = time(NULL);
+
+    // A rejected request fails fast already, it does not open the breaker
+    if ((res != requestRejected) &&
+        (++endpoint->failures >= ENDPOINT_BREAKER_FAILURES))
+    {
+      int seconds = ENDPOINT_RECHECK_SECONDS <<
+        std::min<ui32>(endpoint->trips++, ENDPOINT_BREAKER_DOUBLINGS);
+
+      PRINTF("Endpoint %s circuit breaker open %d seconds\n",
+             endpoint->url.c_str(), seconds);
+      endpoint->reopen = endpoint->failed + seconds +
+                         (time_t)random_jitter(seconds / 4.0);
+    }
+  }
+}
+
+/***********************************************************************/
+/* endpoint_slow: Record the latency of a request cancelled as slower  */
+/*                than another, without a response                     */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint the request was sent to        */
+/*              msec = the time of the request when cancelled, so its  */
+/*                     latency is at least this, in milliseconds       */
+/*                                                                     */
+/*  Note: Unlike a success (endpoint_update), the health and circuit   */
+/*        breaker of the endpoint are unchanged, so an endpoint that   */
+/*        hangs still opens its breaker when not hedged.               */
+/*                                                                     */
+/***********************************************************************/
+static void endpoint_slow(EthereumEndpoint* endpoint, double msec)
+{
+  std::lock_guard<std::mutex> lock(EndpointLock);
+
+  // Only ever slows the moving average, the request did not complete
+  endpoint->samples[endpoint->requests % ENDPOINT_LATENCY_SAMPLES] = msec;
+  if (endpoint->requests++ == 0)
+    endpoint->latency = msec;
+  else if (msec > endpoint->latency)
+    endpoint->latency = (ENDPOINT_EWMA_WEIGHT * msec) +
+                        ((1 - ENDPOINT_EWMA_WEIGHT) * endpoint->latency);
+}
+
+/***********************************************************************/
+/* endpoint_hedge_delay: The latency percentile of an endpoint         */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint of the provider pool           */
+/*              percentile = the latency percentile (1 to 99)          */
+/*                                                                     */
+/*     Returns: the percentile of recent latency, in milliseconds      */
+/*                                                                     */
+/***********************************************************************/
+static double endpoint_hedge_delay(const EthereumEndpoint* endpoint,
+                                   int percentile)
+{
+  double samples[ENDPOINT_LATENCY_SAMPLES];
+  size_t count;
+  std::lock_guard<std::mutex> lock(EndpointLock);
+
+  // Too few samples for a percentile, use the default delay
+  count = std::min<size_t>(endpoint->requests, ENDPOINT_LATENCY_SAMPLES);
+  if (count < HEDGE_MIN_SAMPLES)
+    return HEDGE_DEFAULT_DELAY_MS;
+
+  memcpy(samples, endpoint->samples, count * sizeof(double));
+  size_t nth = std::min(count - 1, (count * percentile) / 100);
+  std::nth_element(samples, samples + nth, samples + count);
+  return samples[nth];
+}
+
+/***********************************************************************/
+/* hedge_start: Start one request of a hedged JSON-RPC call            */
+/*                                                                     */
+/*      Inputs: multi = the curl multi handle of the hedged call       */
+/*              request = the request, with endpoint and response set  */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/*     Returns: zero if started, timedOut or cancelled if the call     */
+/*              ended waiting for a handle, otherwise curlPerformFailed*/
+/*                                                                     */
+/***********************************************************************/
+static int hedge_start(CURLM* multi, HedgeRequest* request,
+                       const char* infuraId, const char* jsonData,
+                       const EthereumDeadline* deadline)
+{
+  int res;
+
+  endpoint_url(request->endpoint.get(), infuraId, request->url);
+  request->easy = curl_handle_acquire(request->url, handleRequest, deadline,
+                                      &res);
+  if (request->easy == NULL)
+  {
+    request->done = true;
+    request->result = res ? res : curlPerformFailed;
+    return request->result;
+  }
+  curl_setup_post(request->easy, request->url, jsonData,
+                  &request->response, deadline);
+  curl_multi_add_handle(multi, request->easy);
+  return 0;
+}
+
+/***********************************************************************/
+/* ethereum_hedge_json: HTTP POST JSON-RPC request to the best endpoint*/
+/*                      and, if it is slow, also to the next endpoint  */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              jsonData = the encoded Json data for function call     */
+/*              priority = the RequestPriority of the request          */
+/*              percentile = the latency percentile to hedge after     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the first successful HTTP response          */
+/*              tried = the endpoints posted to                        */
+/*                                                                     */
+/*     Returns: zero on success, timedOut or cancelled, otherwise      */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int ethereum_hedge_json(const EthereumNetwork* network,
+                               const char* infuraId, const char* jsonData,
+                               JsonResponse* response, int priority,
+                               int percentile,
+                               std::vector<EthereumEndpoint*>& tried,
+                               const EthereumDeadline* deadline)
+{
+  std::chrono::steady_clock::time_point start;
+  HedgeRequest requests[2];
+  bool hedged = false, limited, open;
+  int i, winner = -1, expired = 0;
+  double delay, elapsed, waitMs;
+  CURLMsg* msg;
+  CURLM* multi;
+
+  for (i = 0; i < 2; i++)
+  {
+    requests[i].easy = NULL;
+    requests[i].done = false;
+    requests[i].result = curlPerformFailed;
+    requests[i].response.keepBody = response->keepBody;
+  }
+
+  // Each request parses its own response, the winner is returned
+  requests[0].endpoint = endpoint_select(network, tried, priority,
+                                         &limited, &waitMs, &open);
+  if (requests[0].endpoint == NULL)
+    return curlPerformFailed;
+  tried.push_back(requests[0].endpoint.get());
+
+  // A local node (IPC) answers at once, it is never hedged
+  if (endpoint_is_ipc(requests[0].endpoint->url.c_str()))
+  {
+    double msec = 0;
+    int res;
+
+    endpoint_url(requests[0].endpoint.get(), infuraId, requests[0].url);
+    res = ipc_post_json(requests[0].url, jsonData, response, &msec,
+                        deadline);
+    endpoint_update(requests[0].endpoint.get(), res, msec);
+    return res;
+  }
+
+  // The hedge request, if there is another endpoint, is an extra
+  //   request so is low priority, and never waits.
+  requests[1].endpoint = endpoint_select(network, tried, priorityLow,
+                                         &limited, &waitMs, &open);
+  if ((requests[1].endpoint != NULL) &&
+      endpoint_is_ipc(requests[1].endpoint->url.c_str()))
+    requests[1].endpoint = NULL;
+
+  delay = endpoint_hedge_delay(requests[0].endpoint.get(), percentile);
+  PRINTF("Hedging %s after %.0f ms\n", requests[0].endpoint->url.c_str(),
+         delay);
+
+  multi = curl_multi_init();
+  start = std::chrono::steady_clock::now();
+  hedge_start(multi, &requests[0], infuraId, jsonData, deadline);
+  for (;;)
+  {
+    int running, queued, wait;
+
+    // Progress the requests, stop at the first successful response
+    curl_multi_perform(multi, &running);
+    while ((msg = curl_multi_info_read(multi, &queued)) != NULL)
+    {
+      double msec = 0;
+
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+      i = (msg->easy_handle == requests[0].easy) ? 0 : 1;
+      requests[i].result = curl_result(requests[i].easy,
+                                       msg->data.result, &msec);
+      requests[i].done = true;
+      endpoint_update(requests[i].endpoint.get(), requests[i].result,
+                      msec);
+      curl_multi_remove_handle(multi, requests[i].easy);
+      if ((requests[i].result == 0) && (winner < 0))
+        winner = i;
+    }
+    if (winner >= 0)
+      break;
+
+    elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+
+    // Send the hedge when the primary is slow (or failed already)
+    if (!hedged && (requests[1].endpoint != NULL) &&
+        ((elapsed >= delay) || requests[0].done))
+    {
+      PRINTF("Hedge request to %s\n", requests[1].endpoint->url.c_str());
+      hedged = true;
+      tried.push_back(requests[1].endpoint.get());
+      hedge_start(multi, &requests[1], infuraId, jsonData, deadline);
+      continue;
+    }
+
+    // All requests sent have failed
+    if (requests[0].done && (!hedged || requests[1].done))
+      break;
+
+    // Stop waiting once the call is cancelled or its deadline passed
+    expired = deadline_check(deadline);
+    if (expired)
+      break;
+
+    // Wait for a response, or until the hedge delay or deadline
+    wait = hedged ? 1000 : (int)(delay - elapsed) + 1;
+    if (deadline != NULL)
+    {
+      wait = std::min<long>(wait, deadline_remaining(deadline) + 1);
+      if (deadline->cancel != NULL)
+        wait = std::min(wait, DEADLINE_POLL_MS);
+    }
+    curl_multi_poll(multi, NULL, 0, wait, NULL);
+  }
+
+  elapsed = std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - start).count();
+  for (i = 0; i < 2; i++)
+  {
+    if (requests[i].easy == NULL)
+      continue;
+
+    // Cancel the slower request, charging it the time taken so far
+    //   (or the deadline failure if no request completed)
+    if (!requests[i].done)
+    {
+      curl_multi_remove_handle(multi, requests[i].easy);
+      if (winner >= 0)
+        endpoint_slow(requests[i].endpoint.get(), elapsed);
+      else
+        endpoint_update(requests[i].endpoint.get(), expired, elapsed);
+    }
+    curl_handle_release(requests[i].url, requests[i].easy);
+  }
+  curl_multi_cleanup(multi);
+
+  // Return the winning response to the caller
+  if (winner >= 0)
+  {
+    std::swap(*response, requests[winner].response);
+    return 0;
+  }
+  expired = deadline_check(deadline);
+  return expired ? expired : requests[0].result;
+}
+
+/***********************************************************************/
+/* ethereum_post_json: HTTP POST JSON-RPC request to the provider pool */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              jsonData = the encoded Json data for function call     */
+/*              priority = the RequestPriority of the request          */
+/*              hedge = true to hedge a slow request, if enabled       */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: response = the resulting HTTP response                 */
+/*                                                                     */
+/*     Returns: zero on success, rateLimited if refused by the rate    */
+/*              limit or daily quota, endpointUnavailable if every     */
+/*              circuit breaker is open, timedOut if the deadline      */
+/*              passed, cancelled if cancelled, otherwise the error of */
+/*              the last endpoint                                      */
+/*                                                                     */
+/*  Note: When every endpoint fails with a transient error, the        */
+/*        request is sent again, up to ETHEREUM_MAX_RETRIES times,     */
+/*        after an exponential backoff with jitter.                    */
+/*                                                                     */
+/***********************************************************************/
+static int ethereum_post_json(const EthereumNetwork* network,
+                              const char* infuraId, const char* jsonData,
+                              JsonResponse* response, int priority,
+                              bool hedge, const EthereumDeadline* deadline)
+{
+  std::vector<EthereumEndpoint*> tried;
+  std::shared_ptr<EthereumEndpoint> endpoint;
+  char urlBuf[MAX_SIZE_URL];
+  int res = curlPerformFailed;
+  int percentile = HedgePercentile;
+  int retries = 0;
+  double waited = 0;
+
+  // Hedged first attempt, then fail over to any endpoints not tried
+  if (hedge && (percentile > 0))
+  {
+    res = ethereum_hedge_json(network, infuraId, jsonData, response,
+                              priority, percentile, tried, deadline);
+    if ((res == 0) || (res == cancelled))
+      return res;
+  }
+
+  // Try the fastest healthy endpoint, then the next on each failure
+  for (;;)
+  {
+    double msec = 0, waitMs;
+    bool limited, open;
+    int expired;
+
+    // No failover once the call is cancelled or its deadline passed
+    expired = deadline_check(deadline);
+    if (expired)
+    {
+      res = expired;
+      break;
+    }
+
+    endpoint = endpoint_select(network, tried, priority, &limited,
+                               &waitMs, &open);
+    if (endpoint == NULL)
+    {
+      // Refused before any request was sent, the limit (or the open
+      //   circuit breaker, failing fast) is the error
+      if (limited && tried.empty())
+        res = rateLimited;
+      else if (open && tried.empty())
+        res = endpointUnavailable;
+
+      // Every endpoint failed, retry a transient failure after a
+      //   backoff (with jitter), if within the deadline. A timeout is
+      //   not retried, waiting again would only prolong the stall.
+      else if (!tried.empty() && (priority == priorityHigh) &&
+               (retries < ETHEREUM_MAX_RETRIES) &&
+               (res == curlPerformFailed))
+      {
+        double backoff = (RETRY_BACKOFF_MS << retries) / 2.0;
+
+        backoff += random_jitter(backoff);
+        if (backoff >= deadline_remaining(deadline))
+          break;
+        PRINTF("Retrying in %.0f ms\n", backoff);
+        expired = deadline_sleep(deadline, backoff);
+        if (expired)
+        {
+          res = expired;
+          break;
+        }
+        retries++;
+        tried.clear();
+        continue;
+      }
+
+      // High priority waits (a little) for a rate limit token, but
+      //   not past the deadline
+      if ((waitMs < 0) || (priority == priorityLow) ||
+          (waited + waitMs > RATE_LIMIT_MAX_WAIT_MS) ||
+          (waitMs >= deadline_remaining(deadline)))
+        break;
+      PRINTF("Rate limited, waiting %.0f ms\n", waitMs);
+      expired = deadline_sleep(deadline, waitMs);
+      if (expired)
+      {
+        res = expired;
+        break;
+      }
+      waited += waitMs;
+      continue;
+    }
+
+    endpoint_url(endpoint.get(), infuraId, urlBuf);
+    res = ethereum_send_json(urlBuf, jsonData, response, &msec, deadline);
+    endpoint_update(endpoint.get(), res, msec);
+    if ((res == 0) || (res == cancelled))
+      break;
+    tried.push_back(endpoint.get());
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* autolm_read_activation: activateStatus() contract call, parse result*/
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the Infura ProductID to use                 */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: exp_dat = the expiration date read from the blockchain */
+/*              languages = the resulting licensed language flags      */
+/*              version_plat = the version and platform flags          */
+/*                                                                     */
+/*       Returns: the value of any license activation returned         */
+/*                                                                     */
+/***********************************************************************/
+static int autolm_read_activation(const EthereumNetwork* network,
+  const char* infuraId,
+  const char* jsonData, time_t* exp_dat, ui64* languages,
+  ui64* version_plat, const EthereumDeadline* deadline)
+{
+  JsonResponse response;
+  const char* hex;
+  size_t length;
+  int res;
+
+  // Perform the HTTP request, to the best endpoint of the pool
+  res = ethereum_post_json(network, infuraId, jsonData, &response,
+                           priorityHigh,
+                           true, deadline);
+  if (res == 0)
+  {
+    // Parse the result value and expiration date
+    hex = json_response_result(&response, 0, &length);
+    res = parse_activation_json(hex, length, exp_dat, languages,
+      version_plat);
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* autolm_read_activations: batch of activateStatus() calls in one     */
+/*                          JSON-RPC request, parse each result        */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the Infura ProductID to use                 */
+/*              activations = the activations to look up               */
+/*              count = the number of activations (ETHEREUM_MAX_BATCH) */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: activations = the result of each activation            */
+/*                                                                     */
+/*       Returns: zero if batch performed, otherwise error             */
+/*                                                                     */
+/***********************************************************************/
+static int autolm_read_activations(const EthereumNetwork* network,
+  const char* infuraId,
+  EthereumActivation* activations, int count,
+  const EthereumDeadline* deadline)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = ACTIVATE_STATUS_ID;
+  JsonResponse response;
+  char *jsonData;
+  size_t nLen = 0;
+  int i, res;
+
+  // Allocate the request for the whole batch
+  jsonData = (char*)malloc(count * MAX_SIZE_JSON_BATCH_ITEM + 3);
+  if (jsonData == NULL)
+    return otherLicenseError;
+
+  // Reserve a unique JSON-RPC id for every request of the batch
+  ui32 firstId = JsonRpcId.fetch_add(count);
+
+  // Encode each activateStatus() call as an element of the array
+  jsonData[nLen++] = '[';
+  for (i = 0; i < count; i++)
+  {
+    encode_activate_json(funcId, activations[i].entityId,
+                         activations[i].productId, activations[i].hashId,
+                         jsonParams);
+    if (i > 0)
+      jsonData[nLen++] = ',';
+    nLen += encode_eth_call_json(network_activate_contract(network),
+                                 jsonParams, firstId + i, &jsonData[nLen]);
+
+    // Until a response is matched the activation is not found
+    activations[i].result = blockchainAuthenticationFailed;
+  }
+  jsonData[nLen++] = ']';
+  jsonData[nLen] = 0;
+
+  // Perform the HTTP request, to the best endpoint of the pool
+  res = ethereum_post_json(network, infuraId, jsonData, &response,
+                           priorityHigh,
+                           false, deadline);
+  if (res == 0)
+  {
+    // Responses may be in any order, match each by the request id
+    for (size_t object = 0; object < response.results.size(); object++)
+    {
+      ui32 index = response.results[object].id - firstId;
+      if (index < (ui32)count)
+      {
+        EthereumActivation* activation = &activations[index];
+        size_t length;
+        const char* hex = json_response_result(&response, object,
+                                               &length);
+
+        activation->result = parse_activation_json(hex, length,
+                   &activation->exp_date, &activation->languages,
+                   &activation->version_plat);
+      }
+    }
+  }
+
+  free(jsonData);
+  return res;
+}
+
+/***********************************************************************/
+/* encode_multicall_json: Encode JSON params for Multicall3 call       */
+/*               aggregate3((address, bool, bytes)[])                  */
+/*                                                                     */
+/*      Inputs: contract = the activate contract address (target)      */
+/*              activations = the activations to look up               */
+/*              count = the number of activations                      */
+/*     Outputs: params = the resulting parameters as a hex string      */
+/*                       (MULTICALL_PARAMS_SIZE(count) bytes)          */
+/*                                                                     */
+/***********************************************************************/
+static void encode_multicall_json(const char* contract,
+                                  EthereumActivation* activations,
+                                  int count, char* params)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = ACTIVATE_STATUS_ID;
+  char* next;
+  int i;
+
+  // First encode the function identifier
+  strcpy(params, MULTICALL_AGGREGATE3_ID);
+  next = params + strlen(params);
+
+  // Offset to the Call3[] array, then the array length
+  pack_ll32bytes(0x20, next);
+  next += 64;
+  pack_ll32bytes(count, next);
+  next += 64;
+
+  // Offset of each Call3 tuple, relative to the first offset
+  for (i = 0; i < count; i++, next += 64)
+    pack_ll32bytes((ui64)count * 32 + (ui64)i * MULTICALL_CALL3_SIZE,
+                   next);
+
+  // Each Call3 tuple is (target, allowFailure, callData)
+  for (i = 0; i < count; i++)
+  {
+    encode_activate_json(funcId, activations[i].entityId,
+                         activations[i].productId, activations[i].hashId,
+                         jsonParams);
+
+    pack_hash_to_bytes(&(contract[2]), next); // target
+    next += 64;
+    pack_ll32bytes(1, next); // allow failure, result is per activation
+    next += 64;
+    pack_ll32bytes(0x60, next); // offset to callData within the tuple
+    next += 64;
+
+    // The callData is activateStatus() and parameters, without the 0x
+    pack_ll32bytes(strlen(jsonParams) / 2 - 1, next);
+    next += 64;
+    strcpy(next, &jsonParams[2]);
+    next += strlen(next);
+
+    // Pad callData with zeros to a multiple of 32 bytes
+    while ((next - params - 10) % 64)
+      *next++ = '0';
+  }
+  *next = 0;
+}
+
+/***********************************************************************/
+/* parse_multicall_json: Parse aggregate3() result into each activation*/
+/*                                                                     */
+/*      Inputs: hex = the (bool success, bytes)[] result hex digits    */
+/*              length = the number of result hex digits               */
+/*              count = the number of activations of the call          */
+/*     Outputs: activations = the result of each activation            */
+/*                                                                     */
+/*     Returns: zero on success, otherwise error                       */
+/*                                                                     */
+/***********************************************************************/
+static int parse_multicall_json(const char* hex, size_t length,
+                          EthereumActivation* activations, int count)
+{
+  size_t words, array, tuple, bytes;
+  int i;
+
+  if (hex == NULL)
+    return blockchainAuthenticationFailed;
+  words = length / 64;
+
+// Low 64 bits of a 256 bit word of the result, by word index
+#define MULTICALL_WORD(index) unpack_64bit_value(&hex[(index) * 64 + 48])
+
+  // The result is the offset of the Result[] array, then its length
+  if (words < 2)
+    return blockchainAuthenticationFailed;
+  array = (size_t)MULTICALL_WORD(0) / 32;
+  if ((array >= words) || (MULTICALL_WORD(array) != (ui64)count) ||
+      (array + 1 + count > words))
+    return blockchainAuthenticationFailed;
+
+  for (i = 0; i < count; i++)
+  {
+    EthereumActivation* activation = &activations[i];
+
+    // Each Result tuple is (success, offset to bytes, length, bytes)
+    activation->result = blockchainAuthenticationFailed;
+    tuple = array + 1 + (size_t)MULTICALL_WORD(array + 1 + i) / 32;
+    if ((tuple + 1 >= words) || (MULTICALL_WORD(tuple) == 0))
+      continue;
+    bytes = tuple + (size_t)MULTICALL_WORD(tuple + 1) / 32;
+
+    // activateStatus() returns 2 X 256 bit values (64 bytes)
+    if ((bytes + 3 <= words) && (MULTICALL_WORD(bytes) == 64))
+    {
+      // Parse as though the result of a single activateStatus() call
+      activation->result = parse_activation_json(
+                   &hex[(bytes + 1) * 64], 2 * 64,
+                   &activation->exp_date, &activation->languages,
+                   &activation->version_plat);
+    }
+  }
+#undef MULTICALL_WORD
+  return 0;
+}
+
+/***********************************************************************/
+/* autolm_read_multicall: aggregate activateStatus() calls into one    */
+/*                        Multicall3 eth_call, parse each result       */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the Infura ProductID to use                 */
+/*              activations = the activations to look up               */
+/*              count = the number of activations                      */
+/*                      (ETHEREUM_MAX_MULTICALL)                       */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: activations = the result of each activation            */
+/*                                                                     */
+/*       Returns: zero if call performed, otherwise error              */
+/*                                                                     */
+/***********************************************************************/
+static int autolm_read_multicall(const EthereumNetwork* network,
+  const char* infuraId,
+  EthereumActivation* activations, int count,
+  const EthereumDeadline* deadline)
+{
+  JsonResponse response;
+  char *params, *jsonData;
+  const char* hex;
+  size_t length;
+  int res;
+
+  // Allocate the parameters and request for all calls
+  params = (char*)malloc(MULTICALL_PARAMS_SIZE(count));
+  jsonData = (char*)malloc(MULTICALL_PARAMS_SIZE(count) + 256);
+  if ((params == NULL) || (jsonData == NULL))
+  {
+    free(params);
+    free(jsonData);
+    return otherLicenseError;
+  }
+
+  // Encode all the activateStatus() calls into one aggregate3()
+  encode_multicall_json(network_activate_contract(network), activations,
+                        count, params);
+  encode_eth_call_json(network_multicall_contract(network), params,
+                       JsonRpcId++, jsonData);
+  free(params);
+
+  // Perform the HTTP request, to the best endpoint of the pool
+  res = ethereum_post_json(network, infuraId, jsonData, &response,
+                           priorityHigh,
+                           false, deadline);
+  if (res == 0)
+  {
+    hex = json_response_result(&response, 0, &length);
+    res = parse_multicall_json(hex, length, activations, count);
+  }
+
+  free(jsonData);
+  return res;
+}
+
+/***********************************************************************/
+/* autolm_read_authentication: productReleaseHashDetails() call,       */
+/*                             parse result                            */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the Infura ProductID to use                 */
+/*              jsonData = the encoded Json data for function call     */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: entityId = the entity identifier that created file     */
+/*              productId = the product identifier of the file         */
+/*              releaseId = the release identifier of the file         */
+/*              languages = the resulting licensed language flags      */
+/*              version = the version of the release (X.X.X.X)         */
+/*              uri = the official URI of the file (to download)       */
+/*              uriSize = in the size of uri, out the size needed      */
+/*                                                                     */
+/*       Returns: the value of any license activation returned         */
+/*                                                                     */
+/***********************************************************************/
+static int autolm_read_authentication(const EthereumNetwork* network,
+    const char *infuraId,
+    const char *jsonData, ui64 *entityId, ui64 * productId,
+    ui64 * releaseId, ui64 * languages, ui64 * version, char *uri,
+    size_t *uriSize, const EthereumDeadline* deadline)
+{
+  JsonResponse response;
+  const char* hex;
+  size_t length;
+  int res;
+
+  // Perform the HTTP request, to the best endpoint of the pool
+  res = ethereum_post_json(network, infuraId, jsonData, &response,
+                           priorityHigh,
+                           true, deadline);
+  if (res == 0)
+  {
+    // Parse the result value and expiration date
+    hex = json_response_result(&response, 0, &length);
+    res = parse_authentication_json(hex, length,
+      entityId, productId, releaseId, languages, version, uri, uriSize);
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* async_complete: Parse a completed asynchronous request and call back*/
+/*                                                                     */
+/*      Inputs: transfer = the completed asynchronous request          */
+/*              res = zero if the HTTP request succeeded               */
+/*                                                                     */
+/***********************************************************************/
+static void async_complete(AsyncTransfer* transfer, int res)
+{
+  size_t length;
+  const char* hex = json_response_result(&transfer->response, 0, &length);
+
+  if (transfer->activationCallback)
+  {
+    EthereumActivation* activation = &transfer->activation;
+
+    if (res == 0)
+      res = parse_activation_json(hex, length, &activation->exp_date,
+                                  &activation->languages,
+                                  &activation->version_plat);
+    activation->result = res;
+    transfer->activationCallback(activation, transfer->context);
+  }
+  else if (transfer->releaseCallback)
+  {
+    EthereumRelease* release = &transfer->release;
+    size_t uriSize = sizeof(release->uri);
+
+    if (res == 0)
+      res = parse_authentication_json(hex, length,
+                &release->entityId, &release->productId,
+                &release->releaseId, &release->languages,
+                &release->version, release->uri, &uriSize);
+    release->result = res;
+    transfer->releaseCallback(release, transfer->context);
+  }
+}
+
+/***********************************************************************/
+/* async_start: Set up an asynchronous request to the best endpoint    */
+/*                                                                     */
+/*      Inputs: transfer = the request, with infuraId and jsonData set */
+/*                         and any endpoints already tried             */
+/*                                                                     */
+/*     Returns: zero if ready to perform, rateLimited if refused by    */
+/*              the rate limit or quota, endpointUnavailable if every  */
+/*              circuit breaker is open, otherwise curlPerformFailed   */
+/*                                                                     */
+/***********************************************************************/
+static int async_start(AsyncTransfer* transfer)
+{
+  char urlBuf[MAX_SIZE_URL];
+  double waitMs;
+  bool limited, open;
+
+  // Select the fastest healthy endpoint not yet tried, the event loop
+  //   cannot wait for the rate limit so a limited request fails
+  transfer->endpoint = endpoint_select(&transfer->network,
+                                       transfer->tried, priorityHigh,
+                                       &limited, &waitMs, &open);
+  if (transfer->endpoint == NULL)
+  {
+    if (!transfer->tried.empty())
+      return curlPerformFailed;
+    return limited ? rateLimited :
+           (open ? endpointUnavailable : curlPerformFailed);
+  }
+  endpoint_url(transfer->endpoint.get(), transfer->infuraId.c_str(),
+               urlBuf);
+  transfer->url = urlBuf;
+
+  // A local node (IPC) is sent to by the event loop, without curl
+  if (endpoint_is_ipc(urlBuf))
+    return 0;
+
+  // Easy object to handle the request, from the pool
+  transfer->easy = curl_handle_acquire(urlBuf, handleAsync);
+  if (transfer->easy == NULL)
+    return curlPerformFailed;
+
+  curl_setup_post(transfer->easy, urlBuf, transfer->jsonData.c_str(),
+                  &transfer->response, NULL);
+  curl_easy_setopt(transfer->easy, CURLOPT_PRIVATE, transfer);
+  return 0;
+}
+
+/***********************************************************************/
+/* async_perform: Add a request to the event loop, or to the IPC       */
+/*                thread if the endpoint is a local node (IPC)         */
+/*                                                                     */
+/*      Inputs: transfer = the request, set up by async_start          */
+/*     Outputs: added = the requests added to the curl multi handle    */
+/*                                                                     */
+/***********************************************************************/
+static void async_perform(AsyncTransfer* transfer,
+                          std::vector<AsyncTransfer*>& added)
+{
+  if (transfer->easy == NULL)
+  {
+    std::lock_guard<std::mutex> lock(AsyncLock);
+
+    AsyncIpcQueue.push_back(transfer);
+    AsyncIpcWake.notify_one();
+    return;
+  }
+
+  curl_multi_add_handle(AsyncMulti, transfer->easy);
+  added.push_back(transfer);
+}
+
+/***********************************************************************/
+/* async_ipc_loop: Send the async requests to a local node (IPC), then */
+/*                 return each to the event loop to complete           */
+/*                                                                     */
+/***********************************************************************/
+static void async_ipc_loop(void)
+{
+  std::unique_lock<std::mutex> lock(AsyncLock);
+
+  for (;;)
+  {
+    AsyncTransfer* transfer;
+    double msec = 0;
+
+    AsyncIpcWake.wait(lock, [] { return !AsyncRunning ||
+                                        !AsyncIpcQueue.empty(); });
+    if (!AsyncRunning)
+      break;
+    transfer = AsyncIpcQueue.front();
+    AsyncIpcQueue.erase(AsyncIpcQueue.begin());
+
+    // Send without AsyncLock, the node may take up to IPC_TIMEOUT_MS
+    lock.unlock();
+    transfer->ipcResult = ipc_post_json(transfer->url.c_str(),
+                                        transfer->jsonData.c_str(),
+                                        &transfer->response, &msec, NULL);
+    endpoint_update(transfer->endpoint.get(), transfer->ipcResult, msec);
+    lock.lock();
+
+    AsyncIpcDone.push_back(transfer);
+    curl_multi_wakeup(AsyncMulti);
+  }
+}
+
+/***********************************************************************/
+/* async_event_loop: Drive all asynchronous requests with curl multi   */
+/*                                                                     */
+/***********************************************************************/
+static void async_event_loop(void)
+{
+  std::vector<AsyncTransfer*> added, queue, done;
+  CURLMsg* msg;
+  int running, queued;
+
+  for (;;)
+  {
+    // Add the newly queued requests, exit if shutting down
+    {
+      std::lock_guard<std::mutex> lock(AsyncLock);
+      if (!AsyncRunning)
+        break;
+      queue.swap(AsyncQueue);
+      done.swap(AsyncIpcDone);
+    }
+    for (size_t i = 0; i < queue.size(); i++)
+      async_perform(queue[i], added);
+    queue.clear();
+
+    // Complete the local node (IPC) requests, fail over if they failed
+    for (size_t i = 0; i < done.size(); i++)
+    {
+      AsyncTransfer* transfer = done[i];
+
+      if (transfer->ipcResult != 0)
+      {
+        transfer->tried.push_back(transfer->endpoint.get());
+        if (async_start(transfer) == 0)
+        {
+          async_perform(transfer, added);
+          continue;
+        }
+      }
+      async_complete(transfer, transfer->ipcResult);
+      delete transfer;
+    }
+    done.clear();
+
+    // Progress every request, then complete any that finished
+    curl_multi_perform(AsyncMulti, &running);
+    while ((msg = curl_multi_info_read(AsyncMulti, &queued)) != NULL)
+    {
+      AsyncTransfer* transfer = NULL;
+
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+      curl_multi_remove_handle(AsyncMulti, transfer->easy);
+      added.erase(std::find(added.begin(), added.end(), transfer));
+
+      double msec = 0;
+      int res = curl_result(transfer->easy, msg->data.result, &msec);
+      endpoint_update(transfer->endpoint.get(), res, msec);
+      curl_handle_release(transfer->url.c_str(), transfer->easy);
+      transfer->easy = NULL;
+
+      // On failure resend the request to the next endpoint, if any
+      if (res != 0)
+      {
+        transfer->tried.push_back(transfer->endpoint.get());
+        if (async_start(transfer) == 0)
+        {
+          async_perform(transfer, added);
+          continue;
+        }
+      }
+      async_complete(transfer, res);
+      delete transfer;
+    }
+
+    // Wait for network activity or a new request (wakeup)
+    curl_multi_poll(AsyncMulti, NULL, 0, 1000, NULL);
+  }
+
+  // Shutting down, fail any request still in progress or queued
+  for (size_t i = 0; i < added.size(); i++)
+  {
+    curl_multi_remove_handle(AsyncMulti, added[i]->easy);
+    async_complete(added[i], curlPerformFailed);
+    curl_easy_cleanup(added[i]->easy);
+    delete added[i];
+  }
+
+  // The callbacks may queue requests, so are called without AsyncLock
+  {
+    std::lock_guard<std::mutex> lock(AsyncLock);
+    queue.swap(AsyncQueue);
+  }
+  for (size_t i = 0; i < queue.size(); i++)
+  {
+    async_complete(queue[i], curlPerformFailed);
+    curl_easy_cleanup(queue[i]->easy);
+    delete queue[i];
+  }
+}
+
+/***********************************************************************/
+/* async_ipc_fail: Fail the local node (IPC) requests not completed,   */
+/*                 once the event loop and IPC thread have stopped     */
+/*                                                                     */
+/***********************************************************************/
+static void async_ipc_fail(void)
+{
+  std::vector<AsyncTransfer*> queue, done;
+
+  {
+    std::lock_guard<std::mutex> lock(AsyncLock);
+    queue.swap(AsyncIpcQueue);
+    done.swap(AsyncIpcDone);
+  }
+  for (size_t i = 0; i < queue.size(); i++)
+  {
+    async_complete(queue[i], curlPerformFailed);
+    delete queue[i];
+  }
+  for (size_t i = 0; i < done.size(); i++)
+  {
+    async_complete(done[i], done[i]->ipcResult);
+    delete done[i];
+  }
+}
+
+/***********************************************************************/
+/* cleanup_at_exit: Stop background threads when the process exits    */
+/*                                                                     */
+/*  Note: For applications that do not call EthereumCleanup(), a       */
+/*        thread still running at exit would terminate the process     */
+/*                                                                     */
+/***********************************************************************/
+static void cleanup_at_exit(void)
+{
+  static std::once_flag registered;
+
+  std::call_once(registered, [] { atexit(EthereumCleanup); });
+}
+
+/***********************************************************************/
+/* async_post_json: Queue an asynchronous JSON-RPC HTTP POST request   */
+/*                                                                     */
+/*      Inputs: transfer = the request, with infuraId and jsonData set */
+/*                                                                     */
+/*     Returns: zero if queued, otherwise error                        */
+/*                                                                     */
+/***********************************************************************/
+static int async_post_json(AsyncTransfer* transfer)
+{
+  // Set up the request to the best endpoint of the pool
+  int res = async_start(transfer);
+  if (res != 0)
+  {
+    delete transfer;
+    return res;
+  }
+
+  std::lock_guard<std::mutex> lock(AsyncLock);
+
+  // Not while stopping, for example from the callback of a failed request
+  if (AsyncStopping)
+  {
+    curl_easy_cleanup(transfer->easy);
+    delete transfer;
+    return curlPerformFailed;
+  }
+
+  // Start the event loop thread with the first request, stopping it at
+  //   exit if the application does not call EthereumCleanup()
+  if (!AsyncRunning)
+  {
+    cleanup_at_exit();
+    AsyncMulti = curl_multi_init();
+    AsyncRunning = true;
+    AsyncThread = std::thread(async_event_loop);
+    AsyncIpcThread = std::thread(async_ipc_loop);
+  }
+
+  // Queue the request and wake up the event loop to add it
+  AsyncQueue.push_back(transfer);
+  curl_multi_wakeup(AsyncMulti);
+  return 0;
+}
+
+/***********************************************************************/
+/* autolm_validate_activation: validate a license hash with blockchain */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              deadline = the deadline of the call, NULL for none     */
+/*     Outputs: exp_date = expiration date of the activation (or 0)    */
+/*              languages = language flags for the file                */
+/*              version_plat = version and platform flags              */
+/*                                                                     */
+/*     Returns: the value of any license activation returned           */
+/*                                                                     */
+/***********************************************************************/
+static int autolm_validate_activation(const EthereumNetwork* network,
+      ui64 entityId, ui64 productId, char* hashId, const char* infuraId,
+      time_t* exp_date, ui64* languages, ui64 *version_plat,
+      const EthereumDeadline* deadline)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = ACTIVATE_STATUS_ID;
+
+  // Encode the function parameters as JSON paramters
+  encode_activate_json(funcId, entityId, productId, hashId, jsonParams);
+  PRINTF("%s\n", jsonParams);
+
+  // Encode the eth_call request with a unique JSON-RPC id
+  char jsonDataAll[2048];
+  encode_eth_call_json(network_activate_contract(network), jsonParams,
+                       JsonRpcId++, jsonDataAll);
+  PRINTF("jsonData = %s\n", jsonDataAll);
+  return autolm_read_activation(network, infuraId, jsonDataAll, exp_date,
+                                languages, version_plat, deadline);
+}
+
+/***********************************************************************/
+/* cache_mac: Calculate the HMAC-SHA1 of a cached result               */
+/*                                                                     */
+/*      Inputs: key = the secret key (up to 64 bytes)                  */
+/*              keyLength = the length of the key                      */
+/*              data = the cached result to authenticate               */
+/*              length = the length of the data                       */
+/*     Outputs: mac = the resulting HMAC (SHAHASHBYTES)                */
+/*                                                                     */
+/***********************************************************************/
+static void cache_mac(const ui8* key, ui32 keyLength, const void* data,
+                      size_t length, ui8* mac)
+{
+  ui8 pad[64], inner[SHAHASHBYTES];
+  CSha sha;
+  ShaCtx ctx;
+  int i;
+
+  // HMAC with the key zero extended to the SHA1 block size
+  for (i = 0; i < 64; i++)
+    pad[i] = (((ui32)i < keyLength) ? key[i] : 0) ^ 0x36;
+  sha.ShaInit(&ctx);
+  sha.ShaUpdate(&ctx, pad, 64);
+  sha.ShaUpdate(&ctx, (const ui8*)data, (unsigned int)length);
+  sha.ShaFinal(&ctx, inner);
+
+  for (i = 0; i < 64; i++)
+    pad[i] = (((ui32)i < keyLength) ? key[i] : 0) ^ 0x5C;
+  sha.ShaInit(&ctx);
+  sha.ShaUpdate(&ctx, pad, 64);
+  sha.ShaUpdate(&ctx, inner, SHAHASHBYTES);
+  sha.ShaFinal(&ctx, mac);
+}
+
+/***********************************************************************/
+/* hash_word: Convert an activation hash to a 256 bit hex word         */
+/*                                                                     */
+/*      Inputs: hex = the hash hex string, with or without 0x          */
+/*              length = the number of characters of the hash          */
+/*     Outputs: word = the 64 lower case hex digits, zero padded       */
+/*                                                                     */
+/*     Returns: true if converted, false if not a hex hash             */
+/*                                                                     */
+/***********************************************************************/
+static bool hash_word(const char* hex, size_t length, std::string* word)
+{
+  if ((length >= 2) && (hex[0] == '0') && ((hex[1] == 'x') ||
+                                           (hex[1] == 'X')))
+  {
+    hex += 2;
+    length -= 2;
+  }
+  if ((length == 0) || (length > 64))
+    return false;
+
+  word->assign(64 - length, '0');
+  for (size_t i = 0; i < length; i++)
+  {
+    if (!isxdigit((unsigned char)hex[i]))
+      return false;
+    *word += (char)tolower((unsigned char)hex[i]);
+  }
+  return true;
+}
+
+/***********************************************************************/
+/* hash_tag: The low 64 bits of an activation hash, that match it in   */
+/*           the cache file and shared cache                           */
+/*                                                                     */
+/*      Inputs: word = the activation hash, 64 hex digits              */
+/*                                                                     */
+/*     Returns: the low 64 bits of the hash, zero if not a hash word   */
+/*                                                                     */
+/***********************************************************************/
+static ui64 hash_tag(const std::string& word)
+{
+  return (word.size() == 64) ? strtoull(word.c_str() + 48, NULL, 16) : 0;
+}
+
+/***********************************************************************/
+/* key_hash: The activation hash of the key of an activation lookup,   */
+/*           its third field (entity:product:hash:...)                 */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*     Outputs: word = the activation hash, 64 hex digits              */
+/*                                                                     */
+/*     Returns: true if found, otherwise false                         */
+/*                                                                     */
+/***********************************************************************/
+static bool key_hash(const std::string& key, std::string* word)
+{
+  size_t first = key.find(':'), second, third;
+
+  second = (first == std::string::npos) ? first : key.find(':', first + 1);
+  third = (second == std::string::npos) ? second :
+          key.find(':', second + 1);
+  return (third != std::string::npos) &&
+         hash_word(&key[second + 1], third - second - 1, word);
+}
+
+/***********************************************************************/
+/* cache_digest: Calculate the SHA1 of the key of a lookup             */
+/*                                                                     */
+/*      Inputs: key = the key of the lookup                            */
+/*     Outputs: digest = the resulting SHA1 (SHAHASHBYTES)             */
+/*                                                                     */
+/***********************************************************************/
+static void cache_digest(const char* key, ui8* digest)
+{
+  CSha sha;
+  ShaCtx ctx;
+
+  sha.ShaInit(&ctx);
+  sha.ShaUpdate(&ctx, (const ui8*)key, (unsigned int)strlen(key));
+  sha.ShaFinal(&ctx, digest);
+}
+
+/***********************************************************************/
+/* cache_file_record: Find the record of an activation lookup          */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              create = true to return an unused (or the oldest)      */
+/*                       record if not found                           */
+/*                                                                     */
+/*     Returns: the authentic record found (or created), otherwise     */
+/*              NULL                                                   */
+/*                                                                     */
+/***********************************************************************/
+static CacheFileRecord* cache_file_record(const char* key, bool create)
+{
+  CacheFileRecord* records;
+  CacheFileRecord* oldest = NULL;
+  ui64 oldestValidated = 0;
+  ui8 digest[SHAHASHBYTES], mac[SHAHASHBYTES];
+
+  if (CacheFileMap == NULL)
+    return NULL;
+  cache_digest(key, digest);
+  records = (CacheFileRecord*)(CacheFileMap + sizeof(CacheFileHeader));
+  for (int i = 0; i < CACHE_FILE_RECORDS; i++)
+  {
+    CacheFileRecord* record = &records[i];
+    ui64 validated;
+    ui8 differ = 0;
+
+    // A record that is not authentic (or torn) is not used
+    if (record->validated != 0)
+    {
+      cache_mac(CacheFileKey, CacheFileKeyLength, record,
+                offsetof(CacheFileRecord, mac), mac);
+      for (int j = 0; j < SHAHASHBYTES; j++)
+        differ |= mac[j] ^ record->mac[j];
+    }
+    validated = differ ? 0 : record->validated;
+    if ((validated != 0) &&
+        (memcmp(record->key, digest, SHAHASHBYTES) == 0))
+      return record;
+    if ((oldest == NULL) || (validated < oldestValidated))
+    {
+      oldest = record;
+      oldestValidated = validated;
+    }
+  }
+  if (!create)
+    return NULL;
+
+  memset(oldest, 0, sizeof(CacheFileRecord));
+  memcpy(oldest->key, digest, SHAHASHBYTES);
+  return oldest;
+}
+
+/***********************************************************************/
+/* cache_file_write: Write a changed record to the cache file          */
+/*                                                                     */
+/*      Inputs: record = the record, in the cache file memory          */
+/*                                                                     */
+/***********************************************************************/
+static void cache_file_write(CacheFileRecord* record)
+{
+#ifdef ETHEREUM_PRIVATE_FILES
+  // The file is mapped shared, the record is written by the system
+  (void)record;
+#else
+  FILE* file = fopen(CacheFileName.c_str(), "r+b");
+
+  if (file == NULL)
+    return;
+  fseek(file, (long)((ui8*)record - CacheFileMap), SEEK_SET);
+  fwrite(record, sizeof(CacheFileRecord), 1, file);
+  fclose(file);
+#endif
+}
+
+/***********************************************************************/
+/* cache_file_close: Unmap (or free) the cache file memory             */
+/*                                                                     */
+/***********************************************************************/
+static void cache_file_close(void)
+{
+  if (CacheFileMap == NULL)
+    return;
+#ifdef ETHEREUM_PRIVATE_FILES
+  munmap(CacheFileMap, CacheFileSize);
+#else
+  free(CacheFileMap);
+#endif
+  CacheFileMap = NULL;
+  CacheFileSize = 0;
+}
+
+/***********************************************************************/
+/* cache_file_open: Map (or read) the cache file into memory, creating */
+/*                  it if missing or not a cache file                  */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/***********************************************************************/
+static int cache_file_open(void)
+{
+  size_t size = sizeof(CacheFileHeader) +
+                CACHE_FILE_RECORDS * sizeof(CacheFileRecord);
+  CacheFileHeader* header;
+  bool empty;
+
+#ifdef ETHEREUM_PRIVATE_FILES
+  struct stat st;
+  void* map;
+  int fd = open(CacheFileName.c_str(), O_RDWR | O_CREAT, 0600);
+
+  if (fd < 0)
+    return otherLicenseError;
+  empty = (fstat(fd, &st) != 0) || ((size_t)st.st_size != size);
+  if (empty && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0))
+  {
+    close(fd);
+    return otherLicenseError;
+  }
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return otherLicenseError;
+  CacheFileMap = (ui8*)map;
+#else
+  FILE* file = fopen(CacheFileName.c_str(), "rb");
+
+  CacheFileMap = (ui8*)calloc(1, size);
+  if (CacheFileMap == NULL)
+  {
+    if (file)
+      fclose(file);
+    return otherLicenseError;
+  }
+  empty = (file == NULL) || (fread(CacheFileMap, 1, size, file) != size);
+  if (file)
+    fclose(file);
+#endif
+  CacheFileSize = size;
+
+  // Start a new (empty) cache file if not one of this format
+  header = (CacheFileHeader*)CacheFileMap;
+  if (empty || (memcmp(header->magic, CACHE_FILE_MAGIC, 8) != 0) ||
+      (header->records != CACHE_FILE_RECORDS))
+  {
+    memset(CacheFileMap, 0, size);
+    memcpy(header->magic, CACHE_FILE_MAGIC, 8);
+    header->records = CACHE_FILE_RECORDS;
+#ifndef ETHEREUM_PRIVATE_FILES
+    FILE* out = fopen(CacheFileName.c_str(), "wb");
+    if (out == NULL)
+    {
+      cache_file_close();
+      return otherLicenseError;
+    }
+    fwrite(CacheFileMap, 1, size, out);
+    fclose(out);
+#endif
+  }
+  return 0;
+}
+
+#ifdef ETHEREUM_SHARED_CACHE
+/***********************************************************************/
+/* shared_cache_read: Copy a slot of the shared cache, without locks   */
+/*                                                                     */
+/*      Inputs: slot = the slot in the shared memory segment           */
+/*     Outputs: copy = a consistent copy of the slot                   */
+/*                                                                     */
+/*     Returns: true if copied, false if being written (or abandoned   */
+/*              while written by a process that exited)                */
+/*                                                                     */
+/***********************************************************************/
+static bool shared_cache_read(SharedCacheSlot* slot, SharedCacheSlot* copy)
+{
+  for (int i = 0; i < SHARED_CACHE_READS; i++)
+  {
+    ui32 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+    if (sequence & 1)
+      continue;
+
+    // The copy is consistent if no writer started during it
+    memcpy(copy, slot, sizeof(SharedCacheSlot));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence)
+      return true;
+  }
+  return false;
+}
+
+/***********************************************************************/
+/* shared_cache_write: Write a slot of the shared cache                */
+/*                                                                     */
+/*      Inputs: slot = the slot in the shared memory segment           */
+/*              data = the new contents of the slot                    */
+/*              sequence = the slot sequence when the slot was read    */
+/*                                                                     */
+/*     Returns: true if written, false if written by another writer    */
+/*              since it was read                                      */
+/*                                                                     */
+/***********************************************************************/
+static bool shared_cache_write(SharedCacheSlot* slot,
+                               const SharedCacheSlot* data, ui32 sequence)
+{
+  // An odd sequence excludes other writers and fails concurrent readers
+  if ((sequence & 1) ||
+      !__atomic_compare_exchange_n(&slot->sequence, &sequence,
+         sequence + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return false;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy((ui8*)slot + offsetof(SharedCacheSlot, kind),
+         (const ui8*)data + offsetof(SharedCacheSlot, kind),
+         sizeof(SharedCacheSlot) - offsetof(SharedCacheSlot, kind));
+  __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+  return true;
+}
+
+/***********************************************************************/
+/* shared_cache_slots: The slots a lookup may be stored in             */
+/*                                                                     */
+/*      Inputs: digest = the SHA1 of the key of the lookup             */
+/*                                                                     */
+/*     Returns: the first of SHARED_CACHE_WAYS slots                   */
+/*                                                                     */
+/***********************************************************************/
+static SharedCacheSlot* shared_cache_slots(const ui8* digest)
+{
+  ui32 index = ((ui32)digest[0] << 8) | digest[1];
+
+  index = (index % (SHARED_CACHE_SLOTS / SHARED_CACHE_WAYS)) *
+          SHARED_CACHE_WAYS;
+  return (SharedCacheSlot*)(SharedCacheMap + sizeof(CacheFileHeader)) +
+         index;
+}
+
+/***********************************************************************/
+/* shared_cache_valid: Authenticate a copy of a shared cache slot      */
+/*                                                                     */
+/*      Inputs: copy = the copy of the slot                            */
+/*              digest = the SHA1 of the key of the lookup, or NULL    */
+/*                                                                     */
+/*     Returns: true if authentic (and of the lookup), otherwise false */
+/*                                                                     */
+/***********************************************************************/
+static bool shared_cache_valid(const SharedCacheSlot* copy,
+                               const ui8* digest)
+{
+  ui8 mac[SHAHASHBYTES], differ = 0;
+
+  if ((copy->kind == 0) ||
+      (digest && memcmp(copy->key, digest, SHAHASHBYTES) != 0))
+    return false;
+  cache_mac(SharedCacheKey, SharedCacheKeyLength,
+            (const ui8*)copy + offsetof(SharedCacheSlot, kind),
+            offsetof(SharedCacheSlot, mac) -
+            offsetof(SharedCacheSlot, kind), mac);
+  for (int i = 0; i < SHAHASHBYTES; i++)
+    differ |= mac[i] ^ copy->mac[i];
+  return differ == 0;
+}
+#endif /* ETHEREUM_SHARED_CACHE */
+
+/***********************************************************************/
+/* shared_cache_find: Find a fresh result in the shared cache          */
+/*                                                                     */
+/*      Inputs: key = the key of the lookup                            */
+/*              kind = SHARED_ACTIVATION or SHARED_RELEASE             */
+/*     Outputs: found = a copy of the slot of the result               */
+/*                                                                     */
+/*     Returns: true if found, otherwise false                         */
+/*                                                                     */
+/***********************************************************************/
+static bool shared_cache_find(const char* key, ui32 kind,
+                              SharedCacheSlot* found)
+{
+#ifdef ETHEREUM_SHARED_CACHE
+  std::lock_guard<std::mutex> lock(CacheLock);
+  SharedCacheSlot* slots;
+  ui8 digest[SHAHASHBYTES];
+
+  if (SharedCacheMap == NULL)
+    return false;
+  cache_digest(key, digest);
+  slots = shared_cache_slots(digest);
+  for (int i = 0; i < SHARED_CACHE_WAYS; i++)
+    if (shared_cache_read(&slots[i], found) &&
+        shared_cache_valid(found, digest))
+      return (found->kind == kind) &&
+             ((ui64)time(NULL) < found->fresh);
+#else
+  (void)key;
+  (void)kind;
+  (void)found;
+#endif
+  return false;
+}
+
+/***********************************************************************/
+/* shared_cache_store: Store (or forget) a result in the shared cache, */
+/*                     CacheLock held                                  */
+/*                                                                     */
+/*      Inputs: key = the key of the lookup                            */
+/*              data = kind, fresh, values, result and uri of the      */
+/*                     result, a zero kind to forget the lookup        */
+/*                                                                     */
+/***********************************************************************/
+static void shared_cache_store(const char* key, SharedCacheSlot* data)
+{
+#ifdef ETHEREUM_SHARED_CACHE
+  SharedCacheSlot* slots;
+  SharedCacheSlot* slot = NULL;
+  SharedCacheSlot copy;
+  ui64 oldest = 0;
+  ui32 sequence = 0;
+  bool matched = false;
+
+  if (SharedCacheMap == NULL)
+    return;
+  cache_digest(key, data->key);
+  cache_mac(SharedCacheKey, SharedCacheKeyLength,
+            (const ui8*)data + offsetof(SharedCacheSlot, kind),
+            offsetof(SharedCacheSlot, mac) -
+            offsetof(SharedCacheSlot, kind), data->mac);
+
+  // Replace the slot of this lookup, otherwise an unused (or the
+  //   stalest) slot. A slot being written by another process is skipped.
+  slots = shared_cache_slots(data->key);
+  for (int i = 0; i < SHARED_CACHE_WAYS; i++)
+  {
+    ui64 fresh;
+
+    if (!shared_cache_read(&slots[i], &copy))
+      continue;
+    if (shared_cache_valid(&copy, data->key))
+    {
+      slot = &slots[i];
+      sequence = copy.sequence;
+      matched = true;
+      break;
+    }
+    fresh = shared_cache_valid(&copy, NULL) ? copy.fresh : 0;
+    if ((slot == NULL) || (fresh < oldest))
+    {
+      slot = &slots[i];
+      sequence = copy.sequence;
+      oldest = fresh;
+    }
+  }
+  if (slot && ((data->kind != 0) || matched))
+    shared_cache_write(slot, data, sequence);
+#else
+  (void)key;
+  (void)data;
+#endif
+}
+
+#ifdef ETHEREUM_SHARED_CACHE
+/***********************************************************************/
+/* shared_cache_open: Map the shared memory segment, creating it if    */
+/*                    missing                                          */
+/*                                                                     */
+/*      Inputs: name = the POSIX shared memory name ("/name")          */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/***********************************************************************/
+static int shared_cache_open(const char* name)
+{
+  size_t size = sizeof(CacheFileHeader) +
+                SHARED_CACHE_SLOTS * sizeof(SharedCacheSlot);
+  CacheFileHeader* header;
+  struct stat st;
+  void* map;
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+
+  if (fd < 0)
+    return otherLicenseError;
+
+  // A new segment is empty (zero) once sized, one of another size is
+  //   not of this format so is not used
+  if ((fstat(fd, &st) != 0) ||
+      ((st.st_size == 0) && (ftruncate(fd, size) != 0)) ||
+      ((st.st_size != 0) && ((size_t)st.st_size != size)))
+  {
+    close(fd);
+    return otherLicenseError;
+  }
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return otherLicenseError;
+
+  // The first process marks the format, the slots are already zero
+  header = (CacheFileHeader*)map;
+  if (memcmp(header->magic, SHARED_CACHE_MAGIC, 8) != 0)
+  {
+    header->records = SHARED_CACHE_SLOTS;
+    memcpy(header->magic, SHARED_CACHE_MAGIC, 8);
+  }
+  else if (header->records != SHARED_CACHE_SLOTS)
+  {
+    munmap(map, size);
+    return otherLicenseError;
+  }
+  SharedCacheMap = (ui8*)map;
+  SharedCacheSize = size;
+  return 0;
+}
+#endif /* ETHEREUM_SHARED_CACHE */
+
+/***********************************************************************/
+/* shared_cache_close: Unmap the shared memory segment                 */
+/*                                                                     */
+/***********************************************************************/
+static void shared_cache_close(void)
+{
+#ifdef ETHEREUM_SHARED_CACHE
+  if (SharedCacheMap == NULL)
+    return;
+  munmap(SharedCacheMap, SharedCacheSize);
+  SharedCacheMap = NULL;
+  SharedCacheSize = 0;
+#endif
+}
+
+/***********************************************************************/
+/* activation_revalidate_due: Whether a background validation of an    */
+/*                            activation may start, CacheLock held     */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              now = the current time                                 */
+/*                                                                     */
+/*     Returns: true if none started recently (it is now started),     */
+/*              otherwise false                                        */
+/*                                                                     */
+/***********************************************************************/
+static bool activation_revalidate_due(const char* key, time_t now)
+{
+  time_t interval = std::min((time_t)CACHE_REVALIDATE_SECONDS,
+                             (time_t)CacheTtl);
+  std::map<std::string, time_t>::iterator it = CacheRevalidated.find(key);
+
+  if ((it != CacheRevalidated.end()) && (now < it->second + interval))
+    return false;
+
+  // Forget the lookups long past, so the map stays small
+  if (CacheRevalidated.size() >= CACHE_MAX_ENTRIES)
+  {
+    for (it = CacheRevalidated.begin(); it != CacheRevalidated.end();)
+      if (now >= it->second + interval)
+        it = CacheRevalidated.erase(it);
+      else
+        ++it;
+  }
+  CacheRevalidated[key] = now;
+  return true;
+}
+
+/***********************************************************************/
+/* activation_file_find: Find an activation in the cache file          */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*     Outputs: found = the result of the lookup                       */
+/*              revalidate = true if it is time to validate it again   */
+/*                                                                     */
+/*     Returns: true if found within the grace period, otherwise false */
+/*                                                                     */
+/***********************************************************************/
+static bool activation_file_find(const char* key, ActivationFlight* found,
+                                 bool* revalidate)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+  CacheFileRecord* record = cache_file_record(key, false);
+  time_t now = time(NULL);
+
+  *revalidate = false;
+  if ((record == NULL) || (now >= (time_t)record->validated +
+                                  (time_t)CacheFileGrace) ||
+      ((record->exp_date != 0) && (now >= (time_t)record->exp_date)))
+    return false;
+
+  found->done = true;
+  found->result = record->result;
+  found->exp_date = (time_t)record->exp_date;
+  found->languages = record->languages;
+  found->version_plat = record->version_plat;
+
+  // Validate again once older than the TTL
+  if (now >= (time_t)record->validated + (time_t)CacheTtl)
+    *revalidate = activation_revalidate_due(key, now);
+  return true;
+}
+
+/***********************************************************************/
+/* activation_file_store: Store (or forget) an activation in the cache */
+/*                        file, CacheLock held                         */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              found = the result of the lookup                       */
+/*                                                                     */
+/***********************************************************************/
+static void activation_file_store(const char* key,
+                                  const ActivationFlight& found)
+{
+  bool valid = (found.result == licenseValid) ||
+               (found.result == applicationFeature);
+  CacheFileRecord* record = cache_file_record(key, valid);
+  std::string hash;
+
+  if (record == NULL)
+    return;
+
+  // An activation no longer valid on-chain is forgotten
+  if (!valid)
+  {
+    if (found.result == blockchainExpiredLicense)
+    {
+      record->validated = 0;
+      cache_file_write(record);
+    }
+    return;
+  }
+  record->result = found.result;
+  record->exp_date = (ui64)found.exp_date;
+  record->languages = found.languages;
+  record->version_plat = found.version_plat;
+  record->validated = (ui64)time(NULL);
+  record->hash = key_hash(key, &hash) ? hash_tag(hash) : 0;
+  cache_mac(CacheFileKey, CacheFileKeyLength, record,
+            offsetof(CacheFileRecord, mac), record->mac);
+  cache_file_write(record);
+}
+
+/***********************************************************************/
+/* ethereum_block_number: Read the latest block number with            */
+/*                        eth_blockNumber                              */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/*     Returns: the block number, zero if the request failed           */
+/*                                                                     */
+/***********************************************************************/
+static ui64 ethereum_block_number(const EthereumNetwork* network,
+                                  const char* infuraId,
+                                  const EthereumDeadline* deadline)
+{
+  JsonResponse response;
+  char jsonData[128];
+  const char* hex;
+  size_t length;
+
+  sprintf(jsonData, "{\"jsonrpc\":\"2.0\",\"method\":\"eth_blockNumber\","
+          "\"params\":[],\"id\":%u}", (ui32)JsonRpcId++);
+  if (ethereum_post_json(network, infuraId, jsonData, &response,
+                         priorityHigh, false, deadline) != 0)
+    return 0;
+  hex = json_response_result(&response, 0, &length);
+  if ((hex == NULL) || (length == 0) || (length > 16))
+    return 0;
+  return strtoull(std::string(hex, length).c_str(), NULL, 16);
+}
+
+/***********************************************************************/
+/* chain_head: The latest block number of a network, polled with       */
+/*             eth_blockNumber at most once per interval               */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              deadline = the deadline of the call, NULL for none     */
+/*                                                                     */
+/*     Returns: the block number, zero if not polling or unknown       */
+/*                                                                     */
+/*  Note: While another caller polls, the last block number is used    */
+/*        rather than waiting for the poll                             */
+/*                                                                     */
+/***********************************************************************/
+static ui64 chain_head(const EthereumNetwork* network, const char* infuraId,
+                       const EthereumDeadline* deadline)
+{
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now();
+  ui32 interval = BlockPollMs;
+
+  if ((interval == 0) || (infuraId == NULL))
+    return 0;
+
+  std::string url = network ? network->url : "";
+  std::unique_lock<std::mutex> lock(HeadLock);
+  ChainHead& chainHead = ChainHeads[url];
+  ui64 number;
+
+  if (chainHead.polling ||
+      (now < chainHead.polled + std::chrono::milliseconds(interval)))
+    return chainHead.number;
+
+  // One small request per interval, a failed poll is not repeated
+  //   until the next interval (the TTL applies meanwhile)
+  chainHead.polling = true;
+  chainHead.polled = now;
+  lock.unlock();
+  number = ethereum_block_number(network, infuraId, deadline);
+  lock.lock();
+
+  // The heads may have been cleared meanwhile, see
+  //   EthereumSetBlockPolling()
+  ChainHead& polled = ChainHeads[url];
+  polled.number = number;
+  polled.polled = now;
+  polled.polling = false;
+  PRINTF("Chain head %llu\n", number);
+  return number;
+}
+
+/***********************************************************************/
+/* negative_cache_find: Find a not found result in the negative cache  */
+/*                                                                     */
+/*      Inputs: key = the key of the lookup                            */
+/*              head = the chain head, zero if unknown                 */
+/*     Outputs: result = the cached AutoLmResponse of the lookup       */
+/*                                                                     */
+/*     Returns: true if found, otherwise false                         */
+/*                                                                     */
+/***********************************************************************/
+static bool negative_cache_find(const std::string& key, ui64 head,
+                                int* result)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+  std::map<std::string, NegativeCached>::iterator it =
+    NegativeCache.find(key);
+
+  if (it == NegativeCache.end())
+    return false;
+
+  // A new block may hold the purchase, look up again
+  if ((time(NULL) >= it->second.fresh) ||
+      ((head != 0) && (it->second.block != 0) &&
+       (it->second.block != head)))
+  {
+    NegativeCache.erase(it);
+    return false;
+  }
+  *result = it->second.result;
+  return true;
+}
+
+/***********************************************************************/
+/* negative_cache_store: Cache a not found result, CacheLock held      */
+/*                                                                     */
+/*      Inputs: key = the key of the lookup                            */
+/*              result = blockchainExpiredLicense or blockchainNotFound */
+/*              block = the chain head when looked up, zero if unknown */
+/*                                                                     */
+/***********************************************************************/
+static void negative_cache_store(const std::string& key, int result,
+                                 ui64 block)
+{
+  ui32 ttl = NegativeTtl;
+  time_t now = time(NULL);
+  NegativeCached cached;
+
+  if (ttl == 0)
+    return;
+  cached.result = result;
+  cached.fresh = now + ttl;
+  cached.block = block;
+
+  // When full, drop the stale results, then the first
+  if ((NegativeCache.size() >= NEGATIVE_MAX_ENTRIES) &&
+      (NegativeCache.find(key) == NegativeCache.end()))
+  {
+    std::map<std::string, NegativeCached>::iterator it;
+
+    for (it = NegativeCache.begin(); it != NegativeCache.end();)
+      if (now >= it->second.fresh)
+        it = NegativeCache.erase(it);
+      else
+        ++it;
+    if (NegativeCache.size() >= NEGATIVE_MAX_ENTRIES)
+      NegativeCache.erase(NegativeCache.begin());
+  }
+  NegativeCache[key] = cached;
+}
+
+/***********************************************************************/
+/* activation_cache_find: Find the result of an activation in cache    */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              stale = true to also find a result past its TTL that   */
+/*                      has not expired on-chain                       */
+/*              head = the chain head, zero if unknown                 */
+/*     Outputs: found = the cached result of the lookup                */
+/*              refresh = true if it is time to validate it again in   */
+/*                        the background, see EthereumSetCacheRefresh() */
+/*                                                                     */
+/*     Returns: true if found, otherwise false                         */
+/*                                                                     */
+/***********************************************************************/
+static bool activation_cache_find(const char* key, bool stale, ui64 head,
+                                  ActivationFlight* found, bool* refresh)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+  std::map<std::string, ActivationCached>::iterator it =
+    ActivationCache.find(key);
+  time_t now = time(NULL);
+  ui32 percent = CacheRefresh;
+  bool keyed, fresh;
+
+  *refresh = false;
+  if (it == ActivationCache.end())
+    return false;
+
+  // Fresh until the chain head moves if both blocks are known,
+  //   otherwise until the TTL
+  keyed = (head != 0) && (it->second.found.block != 0);
+  fresh = keyed ? (it->second.found.block == head) :
+                  (now < it->second.fresh);
+
+  // Expired on-chain, it is never served again
+  if ((it->second.found.exp_date != 0) &&
+      (now >= it->second.found.exp_date))
+  {
+    ActivationCache.erase(it);
+    return false;
+  }
+  if (!fresh)
+  {
+
+    // While refreshing, a result past its TTL is served for up to the
+    //   grace period
+    if (!stale && ((percent == 0) ||
+                   (now >= it->second.validated +
+                           ETHEREUM_CACHE_GRACE_SECONDS)))
+      return false;
+  }
+
+  // Validate again in the background once near (or past) the TTL, or
+  //   once the chain head moved
+  if ((percent != 0) &&
+      (keyed ? !fresh : (now >= it->second.validated +
+                         (time_t)((ui64)CacheTtl * percent / 100))))
+    *refresh = activation_revalidate_due(key, now);
+  *found = it->second.found;
+  return true;
+}
+
+/***********************************************************************/
+/* activation_cache_store: Cache the result of an activation lookup    */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              found = the result of the lookup, cached if valid,     */
+/*                      negative cached (and forgotten) if expired     */
+/*                                                                     */
+/***********************************************************************/
+static void activation_cache_store(const char* key,
+                                   const ActivationFlight& found)
+{
+  ui32 ttl = CacheTtl;
+  time_t now = time(NULL);
+  ActivationCached cached;
+  SharedCacheSlot shared;
+  std::string hash;
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  // The cache file keeps valid activations across restarts
+  activation_file_store(key, found);
+  if (found.result == blockchainExpiredLicense)
+  {
+    memset(&shared, 0, sizeof(shared));
+    shared_cache_store(key, &shared);
+    ActivationCache.erase(key);
+    negative_cache_store(key, found.result, found.block);
+    return;
+  }
+  if ((found.result != licenseValid) &&
+      (found.result != applicationFeature))
+    return;
+  NegativeCache.erase(key);
+  if (ttl == 0)
+    return;
+
+  cached.found = found;
+  cached.validated = now;
+  cached.fresh = now + ttl;
+  if ((found.exp_date != 0) && (found.exp_date < cached.fresh))
+    cached.fresh = found.exp_date;
+
+  // Share the result with the other processes on this host
+  memset(&shared, 0, sizeof(shared));
+  shared.kind = SHARED_ACTIVATION;
+  shared.fresh = (ui64)cached.fresh;
+  shared.values[0] = (ui64)found.exp_date;
+  shared.values[1] = found.languages;
+  shared.values[2] = found.version_plat;
+  shared.values[3] = key_hash(key, &hash) ? hash_tag(hash) : 0;
+  shared.result = found.result;
+  shared_cache_store(key, &shared);
+
+  // When full, drop the expired and stale results, then the first
+  if ((ActivationCache.size() >= CACHE_MAX_ENTRIES) &&
+      (ActivationCache.find(key) == ActivationCache.end()))
+  {
+    std::map<std::string, ActivationCached>::iterator it;
+
+    for (it = ActivationCache.begin(); it != ActivationCache.end();)
+      if (now >= it->second.fresh)
+        it = ActivationCache.erase(it);
+      else
+        ++it;
+    if (ActivationCache.size() >= CACHE_MAX_ENTRIES)
+      ActivationCache.erase(ActivationCache.begin());
+  }
+  ActivationCache[key] = cached;
+}
+
+/***********************************************************************/
+/* activation_revalidated: Cache the result of a background validation */
+/*                                                                     */
+/*      Inputs: activation = the result of the validation              */
+/*              context = the ActivationRevalidation (freed)           */
+/*                                                                     */
+/***********************************************************************/
+static void activation_revalidated(const EthereumActivation* activation,
+                                   void* context)
+{
+  ActivationRevalidation* revalidation = (ActivationRevalidation*)context;
+  ActivationFlight found;
+
+  found.done = true;
+  found.result = activation->result;
+  found.exp_date = activation->exp_date;
+  found.languages = activation->languages;
+  found.version_plat = activation->version_plat;
+  found.block = revalidation->block;
+  activation_cache_store(revalidation->key.c_str(), found);
+  delete revalidation;
+}
+
+/***********************************************************************/
+/* activation_revalidate: Validate a cached activation again in the    */
+/*                        background, caching the new result           */
+/*                                                                     */
+/*      Inputs: key = the key of the activation lookup                 */
+/*              entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              network = the network of the call, NULL for defaults   */
+/*              head = the chain head, zero if unknown                 */
+/*                                                                     */
+/***********************************************************************/
+static void activation_revalidate(const char* key, ui64 entityId,
+      ui64 productId, const char* hashId, const char* infuraId,
+      const EthereumNetwork* network, ui64 head)
+{
+  ActivationRevalidation* context;
+
+  if (infuraId == NULL)
+    return;
+  context = new ActivationRevalidation();
+  context->key = key;
+  context->block = head;
+  if (EthereumValidateActivationAsync(entityId, productId, hashId,
+        infuraId, activation_revalidated, context, network) != 0)
+  {
+    PRINTF("Revalidation of %s not started\n", key);
+    delete context;
+  }
+}
+
+/***********************************************************************/
+/* log_words: The 256 bit words of the indexed topics and data of a    */
+/*            log notification                                         */
+/*                                                                     */
+/*      Inputs: message = the eth_subscription notification, or a log  */
+/*                        object of eth_getLogs                        */
+/*     Outputs: words = each word, as 64 lower case hex digits (empty  */
+/*                      for a topic that is not a word)                */
+/*              topics = the number of topics, the first words         */
+/*                                                                     */
+/***********************************************************************/
+static void log_words(const std::string& message,
+                      std::vector<std::string>* words,
+                      size_t* topics = NULL)
+{
+  size_t at, end, start;
+  std::string word;
+  bool signature = true;
+
+  if (topics)
+    *topics = 0;
+
+  // The topics after the first (the event signature)
+  at = message.find("\"topics\"");
+  at = (at == std::string::npos) ? at : message.find('[', at);
+  end = (at == std::string::npos) ? at : message.find(']', at);
+  while (end != std::string::npos)
+  {
+    start = message.find('"', at + 1);
+    if ((start == std::string::npos) || (start > end))
+      break;
+    at = message.find('"', start + 1);
+    if ((at == std::string::npos) || (at > end))
+      break;
+    // A topic keeps its position, even if not a word
+    if (!signature)
+    {
+      if (!hash_word(&message[start + 1], at - start - 1, &word))
+        word.clear();
+      words->push_back(word);
+      if (topics)
+        (*topics)++;
+    }
+    signature = false;
+  }
+
+  // The data, 64 hex digits per word
+  at = message.find("\"data\"");
+  if (at == std::string::npos)
+    return;
+  start = message.find("\"0x", at + 6);
+  end = (start == std::string::npos) ? start : message.find('"', start + 1);
+  for (at = start + 3; (end != std::string::npos) && (at + 64 <= end);
+       at += 64)
+    if (hash_word(&message[at], 64, &word))
+      words->push_back(word);
+}
+
+/***********************************************************************/
+/* activation_stored_expire: Expire the activations of the cache file  */
+/*                           and shared cache, CacheLock held          */
+/*                                                                     */
+/*      Inputs: tags = the hash_tag() of the activation hashes to      */
+/*                     forget, or NULL to validate every one again     */
+/*                                                                     */
+/*     Returns: the number of activations expired                      */
+/*                                                                     */
+/*  Note: Without tags the records of the cache file are kept for the  */
+/*        grace period but are validated again (in the background) on  */
+/*        their next lookup, as if older than the TTL. The activations */
+/*        of the shared cache are forgotten.                           */
+/*                                                                     */
+/***********************************************************************/
+static int activation_stored_expire(const std::vector<ui64>* tags)
+{
+  ui64 stale = (ui64)(time(NULL) - (time_t)CacheTtl);
+  ui8 mac[SHAHASHBYTES];
+  int expired = 0;
+
+  if (CacheFileMap != NULL)
+  {
+    CacheFileRecord* records =
+      (CacheFileRecord*)(CacheFileMap + sizeof(CacheFileHeader));
+
+    for (int i = 0; i < CACHE_FILE_RECORDS; i++)
+    {
+      CacheFileRecord* record = &records[i];
+      ui8 differ = 0;
+
+      // Only an authentic record is expired (and authenticated again)
+      if ((record->validated == 0) ||
+          (tags && (std::find(tags->begin(), tags->end(), record->hash) ==
+                    tags->end())) ||
+          (!tags && (record->validated <= stale)))
+        continue;
+      cache_mac(CacheFileKey, CacheFileKeyLength, record,
+                offsetof(CacheFileRecord, mac), mac);
+      for (int j = 0; j < SHAHASHBYTES; j++)
+        differ |= mac[j] ^ record->mac[j];
+      if (differ != 0)
+        continue;
+      if (tags)
+        record->validated = 0;
+      else
+      {
+        record->validated = stale;
+        cache_mac(CacheFileKey, CacheFileKeyLength, record,
+                  offsetof(CacheFileRecord, mac), record->mac);
+      }
+      cache_file_write(record);
+      expired++;
+    }
+  }
+
+#ifdef ETHEREUM_SHARED_CACHE
+  if (SharedCacheMap != NULL)
+  {
+    SharedCacheSlot* slots =
+      (SharedCacheSlot*)(SharedCacheMap + sizeof(CacheFileHeader));
+    SharedCacheSlot copy, empty;
+
+    memset(&empty, 0, sizeof(empty));
+    for (int i = 0; i < SHARED_CACHE_SLOTS; i++)
+      if (shared_cache_read(&slots[i], &copy) &&
+          shared_cache_valid(&copy, NULL) &&
+          (copy.kind == SHARED_ACTIVATION) &&
+          (!tags || (std::find(tags->begin(), tags->end(),
+                               copy.values[3]) != tags->end())) &&
+          shared_cache_write(&slots[i], &empty, copy.sequence))
+        expired++;
+  }
+#endif
+  return expired;
+}
+
+/***********************************************************************/
+/* activation_cache_evict: Evict (or refresh) the cached activations   */
+/*                         whose hash is in a log of the contract      */
+/*                                                                     */
+/*      Inputs: words = the words of the log                           */
+/*                                                                     */
+/*     Returns: the number of cached activations evicted (or marked)   */
+/*                                                                     */
+/***********************************************************************/
+static int activation_cache_evict(const std::vector<std::string>& words)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+  std::map<std::string, ActivationCached>::iterator it;
+  std::map<std::string, NegativeCached>::iterator neg;
+  ActivationFlight expired;
+  SharedCacheSlot shared;
+  std::vector<ui64> tags;
+  int evicted = 0;
+
+  // The hash of the key is a word of the log
+  struct Match
+  {
+    static bool key(const std::string& key,
+                    const std::vector<std::string>& words)
+    {
+      std::string word;
+
+      return key_hash(key, &word) &&
+             (std::find(words.begin(), words.end(), word) != words.end());
+    }
+  };
+
+  expired.result = blockchainExpiredLicense;
+  for (it = ActivationCache.begin(); it != ActivationCache.end();)
+  {
+    if (!Match::key(it->first, words))
+    {
+      ++it;
+      continue;
+    }
+
+    // The cache file and shared results of this lookup are forgotten,
+    //   and the cached result validated again on its next lookup (in
+    //   the background if refreshing)
+    PRINTF("Activation log for %s\n", it->first.c_str());
+    activation_file_store(it->first.c_str(), expired);
+    memset(&shared, 0, sizeof(shared));
+    shared_cache_store(it->first.c_str(), &shared);
+    CacheRevalidated.erase(it->first);
+    evicted++;
+    if (CacheRefresh != 0)
+    {
+      it->second.fresh = 0;
+      it->second.validated = std::min(it->second.validated,
+                                      time(NULL) - (time_t)CacheTtl);
+      it->second.found.block = 0;
+      ++it;
+    }
+    else
+      it = ActivationCache.erase(it);
+  }
+
+  // An activation not found may be purchased now
+  for (neg = NegativeCache.begin(); neg != NegativeCache.end();)
+    if (Match::key(neg->first, words))
+    {
+      neg = NegativeCache.erase(neg);
+      evicted++;
+    }
+    else
+      ++neg;
+
+  // The results other processes (or a restart) would serve without the
+  //   cache above are forgotten too
+  for (size_t i = 0; i < words.size(); i++)
+    if (hash_tag(words[i]) != 0)
+      tags.push_back(hash_tag(words[i]));
+  if (!tags.empty())
+    evicted += activation_stored_expire(&tags);
+  return evicted;
+}
+
+#ifdef ETHEREUM_WEBSOCKET
+/***********************************************************************/
+/* activation_cache_expire: Validate again every activation of the     */
+/*                          cache file and shared cache                */
+/*                                                                     */
+/***********************************************************************/
+static void activation_cache_expire(void)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  CacheRevalidated.clear();
+  activation_stored_expire(NULL);
+}
+
+/***********************************************************************/
+/* subscribe_message: Handle a message of the log subscription         */
+/*                                                                     */
+/*      Inputs: message = the JSON-RPC message received                */
+/*              reconnected = true if subscribed before, logs may have */
+/*                            been missed                              */
+/*                                                                     */
+/*     Returns: zero on success, otherwise curlPerformFailed if the    */
+/*              subscription failed                                    */
+/*                                                                     */
+/***********************************************************************/
+static int subscribe_message(const std::string& message, bool reconnected)
+{
+  std::vector<std::string> words;
+
+  // A log of the contract, evict the activations it names
+  if (message.find("\"eth_subscription\"") != std::string::npos)
+  {
+    log_words(message, &words);
+    if (activation_cache_evict(words) > 0)
+      PRINTF("Activation log evicted cached results\n");
+    return 0;
+  }
+  if (message.find("\"error\"") != std::string::npos)
+  {
+    PRINTF("Subscription failed %s\n", message.c_str());
+    return curlPerformFailed;
+  }
+
+  // Subscribed again, forget the results logs may have changed since,
+  //   and validate again those of the cache file and other processes
+  if (reconnected && (message.find("\"result\"") != std::string::npos))
+  {
+    EthereumClearCache();
+    EthereumClearNegativeCache();
+    activation_cache_expire();
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* subscribe_session: Subscribe to the logs of the activate contract   */
+/*                    and handle them until disconnected               */
+/*                                                                     */
+/*      Inputs: easy = the connected WebSocket curl handle             */
+/*              contract = the activate contract address               */
+/*              reconnected = true if subscribed before                */
+/*                                                                     */
+/*     Returns: zero if subscribed (until unsubscribed), otherwise     */
+/*              curlPerformFailed                                      */
+/*                                                                     */
+/***********************************************************************/
+static int subscribe_session(CURL* easy, const std::string& contract,
+                             bool reconnected)
+{
+  char buffer[SUBSCRIBE_READ_SIZE], request[256];
+  const struct curl_ws_frame* meta;
+  std::string message;
+  struct pollfd pfd;
+  curl_socket_t sock;
+  size_t length, sent = 0;
+  bool subscribed = false;
+  CURLcode code;
+
+  sprintf(request, "{\"jsonrpc\":\"2.0\",\"id\":%u,\"method\":"
+          "\"eth_subscribe\",\"params\":[\"logs\",{\"address\":\"%s\"}]}",
+          (ui32)JsonRpcId++, contract.c_str());
+  length = strlen(request);
+  if ((curl_easy_getinfo(easy, CURLINFO_ACTIVESOCKET, &sock) != CURLE_OK)
+      || (sock == CURL_SOCKET_BAD))
+    return curlPerformFailed;
+
+  while (SubscribeRunning)
+  {
+    // Send the subscription, then read messages until none is waiting
+    if (sent < length)
+    {
+      size_t n = 0;
+
+      code = curl_ws_send(easy, request + sent, length - sent, &n, 0,
+                          CURLWS_TEXT);
+      if ((code != CURLE_OK) && (code != CURLE_AGAIN))
+        break;
+      sent += n;
+    }
+    for (;;)
+    {
+      size_t n = 0;
+
+      code = curl_ws_recv(easy, buffer, sizeof(buffer), &n, &meta);
+      if (code != CURLE_OK)
+        break;
+      if (meta->flags & CURLWS_CLOSE)
+      {
+        code = CURLE_RECV_ERROR;
+        break;
+      }
+      message.append(buffer, n);
+      if ((meta->bytesleft == 0) && !(meta->flags & CURLWS_CONT))
+      {
+        if (subscribe_message(message, reconnected))
+          return curlPerformFailed;
+        subscribed = true;
+        message.clear();
+      }
+    }
+    if (code != CURLE_AGAIN)
+      break;
+
+    // Wait for the node, checking if unsubscribed
+    pfd.fd = sock;
+    pfd.events = POLLIN | ((sent < length) ? POLLOUT : 0);
+    pfd.revents = 0;
+    if ((poll(&pfd, 1, SUBSCRIBE_POLL_MS) < 0) && (errno != EINTR))
+      break;
+  }
+  return (subscribed || !SubscribeRunning) ? 0 : curlPerformFailed;
+}
+
+/***********************************************************************/
+/* subscribe_progress: Abort the connect of the subscription once it   */
+/*                     is stopped                                      */
+/*                                                                     */
+/*     Returns: zero to continue, otherwise abort the transfer         */
+/*                                                                     */
+/***********************************************************************/
+static int subscribe_progress(void* clientp, curl_off_t dltotal,
+                              curl_off_t dlnow, curl_off_t ultotal,
+                              curl_off_t ulnow)
+{
+  return SubscribeRunning ? 0 : 1;
+}
+
+/***********************************************************************/
+/* subscribe_loop: Keep the log subscription, reconnecting with a      */
+/*                 backoff until unsubscribed                          */
+/*                                                                     */
+/*      Inputs: url = the WebSocket URL of the node (ws:// or wss://)  */
+/*              contract = the activate contract address               */
+/*                                                                     */
+/***********************************************************************/
+static void subscribe_loop(std::string url, std::string contract)
+{
+  bool reconnected = false;
+  int failures = 0;
+
+  while (SubscribeRunning)
+  {
+    CURL* easy;
+    double backoff;
+
+    {
+      std::lock_guard<std::mutex> lock(CurlPoolLock);
+      curl_global_start();
+    }
+    easy = curl_easy_init();
+    if (easy)
+    {
+      curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+      curl_easy_setopt(easy, CURLOPT_CONNECT_ONLY, 2L); // WebSocket
+      curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS,
+                       (long)ETHEREUM_TIMEOUT_MS);
+      curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+      curl_easy_setopt(easy, CURLOPT_SHARE, CurlShare);
+      curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, subscribe_progress);
+      curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+      if ((curl_easy_perform(easy) == CURLE_OK) &&
+          (subscribe_session(easy, contract, reconnected) == 0))
+      {
+        reconnected = true;
+        failures = 0;
+      }
+      else
+        failures++;
+      curl_easy_cleanup(easy);
+    }
+    else
+      failures++;
+
+    // Reconnect after an exponential backoff with jitter
+    backoff = std::min((double)SUBSCRIBE_BACKOFF_MAX_MS,
+                       (double)RETRY_BACKOFF_MS *
+                       (1 << std::min(failures, 10)));
+    backoff = backoff / 2 + random_jitter(backoff / 2);
+    PRINTF("Subscription lost, reconnecting in %.0f ms\n", backoff);
+    for (std::chrono::steady_clock::time_point until =
+           std::chrono::steady_clock::now() +
+           std::chrono::milliseconds((long)backoff);
+         SubscribeRunning && (std::chrono::steady_clock::now() < until);)
+      std::this_thread::sleep_for(
+        std::chrono::milliseconds(DEADLINE_POLL_MS));
+  }
+}
+#endif /* ETHEREUM_WEBSOCKET */
+
+/***********************************************************************/
+/* filter_mix: Mix the bits of a number, so each bit of the result     */
+/*             depends on every bit of the value (splitmix64)          */
+/*                                                                     */
+/*      Inputs: value = the number to mix                              */
+/*                                                                     */
+/*     Returns: the mixed number                                       */
+/*                                                                     */
+/***********************************************************************/
+static ui64 filter_mix(ui64 value)
+{
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+/***********************************************************************/
+/* filter_element: The bit positions of an activation in the filter,   */
+/*                 first + i * step for each of the filter hashes      */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id of the activation             */
+/*              productId = the product Id of the activation           */
+/*              word = the activation hash, 64 hex digits              */
+/*              seed = the seed of the filter                          */
+/*     Outputs: first = the first bit position (before the modulo)     */
+/*              step = the step between positions, odd                 */
+/*                                                                     */
+/*     Returns: true if converted, false if not a hash word            */
+/*                                                                     */
+/***********************************************************************/
+static bool filter_element(ui64 entityId, ui64 productId,
+                           const std::string& word, ui64 seed,
+                           ui64* first, ui64* step)
+{
+  ui64 value = filter_mix(seed ^ entityId), part;
+  char digit;
+
+  if (word.size() != 64)
+    return false;
+  for (int i = 0; i < 4; i++)
+  {
+    for (part = 0, digit = 0; digit < 16; digit++)
+    {
+      char hex = word[16 * i + digit];
+
+      part = (part << 4) | (ui64)((hex <= '9') ? hex - '0' : hex - 'a' + 10);
+    }
+    value = filter_mix(value ^ part);
+  }
+  *first = filter_mix(value ^ productId);
+  *step = filter_mix(*first) | 1;
+  return true;
+}
+
+/***********************************************************************/
+/* filter_add: Add a valid activation of the filtered entity to the    */
+/*             filter                                                  */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id of the activation             */
+/*              productId = the product Id of the activation           */
+/*              word = the activation hash, 64 hex digits              */
+/*                                                                     */
+/***********************************************************************/
+static void filter_add(ui64 entityId, ui64 productId,
+                       const std::string& word)
+{
+  std::lock_guard<std::mutex> lock(FilterLock);
+  ui64 first, step, bit;
+
+  if (FilterBits.empty() || (entityId != FilterEntity) ||
+      !filter_element(entityId, productId, word, FilterSeed, &first, &step))
+    return;
+  for (ui32 i = 0; i < FilterHashes; i++)
+  {
+    bit = (first + i * step) % (FilterBits.size() * 64);
+    FilterBits[bit / 64] |= 1ULL << (bit % 64);
+  }
+}
+
+/***********************************************************************/
+/* sync_logs: Read the logs of the activate contract in a block range  */
+/*            with eth_getLogs                                         */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              from = the first block of the range                    */
+/*              to = the last block of the range                       */
+/*     Outputs: logs = the words of each log, see log_words()          */
+/*              topics = the number of topics of each log              */
+/*                                                                     */
+/*     Returns: zero on success, otherLicenseError if the node refused */
+/*              the range (too many logs), otherwise the error of the  */
+/*              request                                                */
+/*                                                                     */
+/***********************************************************************/
+static int sync_logs(const EthereumNetwork* network, const char* infuraId,
+                     ui64 from, ui64 to,
+                     std::vector<std::vector<std::string> >* logs,
+                     std::vector<size_t>* topics)
+{
+  JsonResponse response;
+  char jsonData[256];
+  size_t at, start = 0;
+  bool inString = false, escape = false;
+  int depth = 0, res;
+
+  sprintf(jsonData, "{\"jsonrpc\":\"2.0\",\"method\":\"eth_getLogs\","
+          "\"params\":[{\"address\":\"%s\",\"fromBlock\":\"0x%llx\","
+          "\"toBlock\":\"0x%llx\"}],\"id\":%u}",
+          network_activate_contract(network), from, to, (ui32)JsonRpcId++);
+  response.keepBody = true;
+  res = ethereum_post_json(network, infuraId, jsonData, &response,
+                           priorityLow, false, NULL);
+  if (res != 0)
+    return res;
+
+  const std::string& body = response.body;
+  if ((body.find("\"error\"") != std::string::npos) ||
+      (body.find("\"result\"") == std::string::npos))
+  {
+    PRINTF("eth_getLogs %llu to %llu refused\n", from, to);
+    return otherLicenseError;
+  }
+
+  // Each log object of the result array
+  for (at = 0; at < body.size(); at++)
+  {
+    char ch = body[at];
+
+    if (inString)
+    {
+      if (escape)
+        escape = false;
+      else if (ch == '\\')
+        escape = true;
+      else if (ch == '"')
+        inString = false;
+    }
+    else if (ch == '"')
+      inString = true;
+    else if ((ch == '{') || (ch == '['))
+    {
+      if (++depth == 3)
+        start = at;
+    }
+    else if ((ch == '}') || (ch == ']'))
+    {
+      if ((depth-- == 3) && (ch == '}'))
+      {
+        logs->push_back(std::vector<std::string>());
+        topics->push_back(0);
+        log_words(body.substr(start, at + 1 - start), &logs->back(),
+                  &topics->back());
+      }
+    }
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* sync_validate: Validate activation hashes of the synced entity and  */
+/*                update the index                                     */
+/*                                                                     */
+/*      Inputs: entityId = the synced entity                           */
+/*              products = the synced products of the entity           */
+/*              hashes = the activation hashes, 64 hex digits          */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              network = the network of the calls, NULL for defaults  */
+/*                                                                     */
+/*     Returns: zero on success, otherwise the error of the calls      */
+/*                                                                     */
+/***********************************************************************/
+static int sync_validate(ui64 entityId, const std::vector<ui64>& products,
+                         const std::vector<std::string>& hashes,
+                         const char* infuraId,
+                         const EthereumNetwork* network)
+{
+  std::vector<EthereumActivation> activations;
+  std::map<std::string, SyncedActivation>::iterator it;
+  EthereumActivation activation;
+  size_t i, j;
+  int res;
+
+  // Each hash is looked up for each product, as the logs do not say
+  memset(&activation, 0, sizeof(activation));
+  activation.entityId = entityId;
+  for (i = 0; i < hashes.size(); i++)
+    for (j = 0; j < products.size(); j++)
+    {
+      activation.productId = products[j];
+      snprintf(activation.hashId, sizeof(activation.hashId), "0x%s",
+               hashes[i].c_str());
+      activations.push_back(activation);
+    }
+  if (activations.empty())
+    return 0;
+  res = EthereumValidateActivations(activations.data(),
+                                    (int)activations.size(), infuraId,
+                                    network);
+  if (res != 0)
+    return res;
+
+  std::lock_guard<std::mutex> lock(SyncIndexLock);
+  for (i = 0; i < activations.size(); i++)
+  {
+    const std::string& hash = hashes[i / products.size()];
+
+    if ((activations[i].result == licenseValid) ||
+        (activations[i].result == applicationFeature))
+    {
+      SyncedActivation& synced = SyncIndex[hash];
+
+      synced.productId = activations[i].productId;
+      synced.found.done = true;
+      synced.found.result = activations[i].result;
+      synced.found.exp_date = activations[i].exp_date;
+      synced.found.languages = activations[i].languages;
+      synced.found.version_plat = activations[i].version_plat;
+      filter_add(entityId, activations[i].productId, hash);
+    }
+
+    // No longer valid on-chain, it is forgotten
+    else if (activations[i].result == blockchainExpiredLicense)
+    {
+      it = SyncIndex.find(hash);
+      if ((it != SyncIndex.end()) &&
+          (it->second.productId == activations[i].productId))
+        SyncIndex.erase(it);
+    }
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* sync_round: Sync the index with the logs of the blocks not yet      */
+/*             synced, up to the chain head                            */
+/*                                                                     */
+/*      Inputs: entityId = the synced entity                           */
+/*              products = the synced products of the entity           */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              network = the network of the calls, NULL for defaults  */
+/*              next = the first block not yet synced, zero for the    */
+/*                     chain head                                      */
+/*              range = the blocks read by one eth_getLogs             */
+/*              following = true once backfilled, the logs are new     */
+/*     Outputs: next = the first block not yet synced                  */
+/*              range = halved if refused, doubled (to the maximum)    */
+/*                      once read                                      */
+/*                                                                     */
+/*     Returns: zero if synced to the chain head, otherwise error      */
+/*                                                                     */
+/***********************************************************************/
+static int sync_round(ui64 entityId, const std::vector<ui64>& products,
+                      const char* infuraId, const EthereumNetwork* network,
+                      ui64* next, ui64* range, bool following)
+{
+  std::vector<std::vector<std::string> > logs;
+  std::vector<std::string> hashes;
+  std::vector<size_t> topics;
+  char entity[65];
+  ui64 head, to;
+  size_t i, j;
+  int res;
+
+  head = ethereum_block_number(network, infuraId, NULL);
+  if (head == 0)
+    return curlPerformFailed;
+  if (*next == 0)
+    *next = head;
+  snprintf(entity, sizeof(entity), "%064llx", entityId);
+
+  while (SyncRunning && (*next <= head))
+  {
+    to = std::min(head, *next + *range - 1);
+    logs.clear();
+    topics.clear();
+    hashes.clear();
+    res = sync_logs(network, infuraId, *next, to, &logs, &topics);
+    if ((res == otherLicenseError) && (to > *next))
+    {
+      *range = (to - *next + 1) / 2;
+      continue;
+    }
+    if (res != 0)
+      return res;
+
+    // A log of the entity (its indexed topic) names its activation
+    //   hash (a word above 64 bits), a log naming an indexed hash may
+    //   have changed it
+    for (i = 0; i < logs.size(); i++)
+    {
+      bool ours = (topics[i] >= ETHEREUM_SYNC_ENTITY_TOPIC) &&
+                  (logs[i][ETHEREUM_SYNC_ENTITY_TOPIC - 1] == entity);
+
+      if (following && (activation_cache_evict(logs[i]) > 0))
+        PRINTF("Activation log evicted cached results\n");
+      std::lock_guard<std::mutex> lock(SyncIndexLock);
+      for (j = 0; j < logs[i].size(); j++)
+        SyncLogged[hash_tag(logs[i][j]) % SYNC_LOGGED_SLOTS] = to;
+      for (j = 0; j < logs[i].size(); j++)
+        if ((ours && (logs[i][j] != entity) &&
+             (logs[i][j].find_first_not_of('0') < 48)) ||
+            (SyncIndex.find(logs[i][j]) != SyncIndex.end()))
+          hashes.push_back(logs[i][j]);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    res = sync_validate(entityId, products, hashes, infuraId, network);
+    if (res != 0)
+      return res;
+    PRINTF("Synced blocks %llu to %llu, %u hashes\n", *next, to,
+           (ui32)hashes.size());
+    *next = to + 1;
+    *range = std::min((ui64)ETHEREUM_SYNC_RANGE_BLOCKS, *range * 2);
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* sync_deployed: Check if a backfill starts at (or before) the deploy */
+/*                block of the activate contract, with eth_getCode     */
+/*                                                                     */
+/*      Inputs: network = the network of the call, NULL for defaults   */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              from = the first block of the backfill                 */
+/*                                                                     */
+/*     Returns: 1 if the contract has no code before the block, zero   */
+/*              if it has, otherwise -1 if the request failed          */
+/*                                                                     */
+/***********************************************************************/
+static int sync_deployed(const EthereumNetwork* network,
+                         const char* infuraId, ui64 from)
+{
+  JsonResponse response;
+  char jsonData[256];
+  size_t length;
+
+  if (from <= 1)
+    return 1;
+  sprintf(jsonData, "{\"jsonrpc\":\"2.0\",\"method\":\"eth_getCode\","
+          "\"params\":[\"%s\",\"0x%llx\"],\"id\":%u}",
+          network_activate_contract(network), from - 1, (ui32)JsonRpcId++);
+  if ((ethereum_post_json(network, infuraId, jsonData, &response,
+                          priorityLow, false, NULL) != 0) ||
+      (json_response_result(&response, 0, &length) == NULL))
+    return -1;
+  return (length == 0) ? 1 : 0;
+}
+
+/***********************************************************************/
+/* sync_loop: Backfill, then follow the logs of the activate contract  */
+/*            until stopped                                            */
+/*                                                                     */
+/*      Inputs: entityId = the synced entity                           */
+/*              products = the synced products of the entity           */
+/*              next = the first block to sync, zero for the head      */
+/*              interval = milliseconds between syncs                  */
+/*              infuraId = the provider (Infura) Id to use             */
+/*              network = the network of the calls                     */
+/*              networked = false to use the default network           */
+/*                                                                     */
+/***********************************************************************/
+static void sync_loop(ui64 entityId, std::vector<ui64> products, ui64 next,
+                      ui32 interval, std::string infuraId,
+                      EthereumNetwork network, bool networked)
+{
+  ui64 range = ETHEREUM_SYNC_RANGE_BLOCKS;
+  bool following = false, checked = (next == 0);
+
+  while (SyncRunning)
+  {
+    // A backfill from the deploy block indexes every activation
+    if (!checked)
+    {
+      int deployed = sync_deployed(networked ? &network : NULL,
+                                   infuraId.c_str(), next);
+
+      if (deployed >= 0)
+      {
+        std::lock_guard<std::mutex> lock(SyncIndexLock);
+
+        SyncComplete = (deployed == 1);
+        checked = true;
+      }
+    }
+
+    // The index answers lookups while synced to the chain head
+    if (sync_round(entityId, products, infuraId.c_str(),
+                   networked ? &network : NULL, &next, &range,
+                   following) == 0)
+    {
+      std::lock_guard<std::mutex> lock(SyncIndexLock);
+
+      SyncCurrent = true;
+      SyncSynced = std::chrono::steady_clock::now();
+      SyncBlock = next - 1;
+      following = true;
+
+      // A filter built from the index has every activation synced since
+      std::lock_guard<std::mutex> filterLock(FilterLock);
+      if (FilterSynced)
+      {
+        FilterBlock = SyncBlock;
+        FilterCreated = (ui64)time(NULL);
+      }
+    }
+    else
+      PRINTF("Sync failed at block %llu\n", next);
+
+    for (std::chrono::steady_clock::time_point until =
+           std::chrono::steady_clock::now() +
+           std::chrono::milliseconds(interval);
+         SyncRunning && (std::chrono::steady_clock::now() < until);)
+      std::this_thread::sleep_for(
+        std::chrono::milliseconds(DEADLINE_POLL_MS));
+  }
+}
+
+/***********************************************************************/
+/* sync_find: Find an activation in the index of the synced entity     */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id of the lookup                 */
+/*              productId = the product Id of the lookup               */
+/*              hashId = the activation hash of the lookup             */
+/*              network = the network of the lookup, NULL for defaults */
+/*     Outputs: found = the result of the last validation              */
+/*                                                                     */
+/*     Returns: true if found in an index synced recently              */
+/*                                                                     */
+/***********************************************************************/
+static bool sync_find(ui64 entityId, ui64 productId, const char* hashId,
+                      const EthereumNetwork* network,
+                      ActivationFlight* found)
+{
+  std::map<std::string, SyncedActivation>::iterator it;
+  std::string hash;
+
+  if (!SyncRunning || (hashId == NULL) ||
+      !hash_word(hashId, strlen(hashId), &hash))
+    return false;
+
+  std::lock_guard<std::mutex> lock(SyncIndexLock);
+  if (!SyncCurrent || (entityId != SyncEntity) ||
+      (SyncUrl != (network ? network->url : "")) ||
+      (std::chrono::steady_clock::now() > SyncSynced +
+         std::chrono::milliseconds((ui64)SyncInterval *
+                                   SYNC_STALE_INTERVALS)))
+    return false;
+  it = SyncIndex.find(hash);
+  if ((it == SyncIndex.end()) || (it->second.productId != productId))
+    return false;
+
+  // Expired on-chain, it is never served again
+  if ((it->second.found.exp_date != 0) &&
+      (time(NULL) >= it->second.found.exp_date))
+  {
+    SyncIndex.erase(it);
+    return false;
+  }
+  *found = it->second.found;
+  return true;
+}
+
+/***********************************************************************/
+/* sync_block: The last block of the logs the sync has read, before a  */
+/*             lookup, see sync_store()                                */
+/*                                                                     */
+/*     Returns: the block synced to, zero if none                      */
+/*                                                                     */
+/***********************************************************************/
+static ui64 sync_block(void)
+{
+  std::lock_guard<std::mutex> lock(SyncIndexLock);
+
+  return SyncBlock;
+}
+
+/***********************************************************************/
+/* sync_store: Keep the result of a lookup of the synced entity in the */
+/*             index, so its logs keep it current                      */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id of the lookup                 */
+/*              productId = the product Id of the lookup               */
+/*              hashId = the activation hash of the lookup             */
+/*              network = the network of the lookup, NULL for defaults */
+/*              found = the result of the lookup                       */
+/*              since = the sync_block() when the lookup was sent      */
+/*                                                                     */
+/*  Note: A valid result is dropped if the sync has since read a log   */
+/*        naming the hash, the log may have revoked it after the       */
+/*        lookup read it (and the sync validates it again).            */
+/*                                                                     */
+/***********************************************************************/
+static void sync_store(ui64 entityId, ui64 productId, const char* hashId,
+                       const EthereumNetwork* network,
+                       const ActivationFlight& found, ui64 since)
+{
+  std::map<std::string, SyncedActivation>::iterator it;
+  std::string hash;
+
+  if (!SyncRunning || (hashId == NULL) ||
+      !hash_word(hashId, strlen(hashId), &hash))
+    return;
+
+  std::lock_guard<std::mutex> lock(SyncIndexLock);
+  if ((entityId != SyncEntity) ||
+      (SyncUrl != (network ? network->url : "")) ||
+      (std::find(SyncProducts.begin(), SyncProducts.end(), productId) ==
+       SyncProducts.end()))
+    return;
+  if ((found.result == licenseValid) ||
+      (found.result == applicationFeature))
+  {
+    if (SyncLogged[hash_tag(hash) % SYNC_LOGGED_SLOTS] > since)
+    {
+      PRINTF("Activation %s logged during the lookup\n", hash.c_str());
+      return;
+    }
+    SyncIndex[hash].productId = productId;
+    SyncIndex[hash].found = found;
+    SyncIndex[hash].found.done = true;
+    filter_add(entityId, productId, hash);
+  }
+  else if (found.result == blockchainExpiredLicense)
+  {
+    it = SyncIndex.find(hash);
+    if ((it != SyncIndex.end()) && (it->second.productId == productId))
+      SyncIndex.erase(it);
+  }
+}
+
+/***********************************************************************/
+/* snapshot_order: Convert a number of the snapshot file (little       */
+/*                 endian) to or from the order of this computer       */
+/*                                                                     */
+/*      Inputs: value = the number to convert                          */
+/*                                                                     */
+/*     Returns: the converted number                                   */
+/*                                                                     */
+/***********************************************************************/
+static ui64 snapshot_order(ui64 value)
+{
+  const ui16 probe = 1;
+  ui64 swapped = 0;
+
+  if (*(const ui8*)&probe == 1)
+    return value;
+  for (int i = 0; i < 8; i++)
+    swapped = (swapped << 8) | ((value >> (8 * i)) & 0xFF);
+  return swapped;
+}
+
+/***********************************************************************/
+/* snapshot_hash: Convert an activation hash to the 32 byte key of the */
+/*                snapshot records                                     */
+/*                                                                     */
+/*      Inputs: hashId = the hash hex string, with or without 0x       */
+/*     Outputs: hash = the hash, big endian and zero padded            */
+/*                                                                     */
+/*     Returns: true if converted, false if not a hex hash             */
+/*                                                                     */
+/***********************************************************************/
+static bool snapshot_hash(const char* hashId, ui8* hash)
+{
+  std::string word;
+
+  if ((hashId == NULL) || !hash_word(hashId, strlen(hashId), &word))
+    return false;
+  for (int i = 0; i < 32; i++)
+    hash[i] = (ui8)strtoul(word.substr(2 * i, 2).c_str(), NULL, 16);
+  return true;
+}
+
+/***********************************************************************/
+/* snapshot_close: Unmap (or free) the snapshot, SnapshotLock held     */
+/*                                                                     */
+/***********************************************************************/
+static void snapshot_close(void)
+{
+  if (SnapshotMap == NULL)
+    return;
+#ifdef ETHEREUM_PRIVATE_FILES
+  munmap(SnapshotMap, SnapshotSize);
+#else
+  free(SnapshotMap);
+#endif
+  SnapshotMap = NULL;
+  SnapshotSize = 0;
+}
+
+/***********************************************************************/
+/* snapshot_find: Find an activation in the snapshot file              */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id of the lookup                 */
+/*              productId = the product Id of the lookup               */
+/*              hashId = the activation hash of the lookup             */
+/*     Outputs: found = the activation of the snapshot                 */
+/*                                                                     */
+/*     Returns: true if found, not expired                             */
+/*                                                                     */
+/***********************************************************************/
+static bool snapshot_find(ui64 entityId, ui64 productId, const char* hashId,
+                          ActivationFlight* found)
+{
+  std::lock_guard<std::mutex> lock(SnapshotLock);
+  const SnapshotHeader* header = (const SnapshotHeader*)SnapshotMap;
+  const SnapshotRecord* records;
+  const SnapshotRecord* record = NULL;
+  ui8 hash[32];
+  ui64 low = 0, high;
+  time_t exp_date;
+
+  if ((header == NULL) ||
+      (snapshot_order(header->entityId) != entityId) ||
+      !snapshot_hash(hashId, hash))
+    return false;
+
+  // Binary search of the records, sorted by hash
+  records = (const SnapshotRecord*)(SnapshotMap + sizeof(SnapshotHeader));
+  high = snapshot_order(header->records);
+  while (low < high)
+  {
+    ui64 middle = low + (high - low) / 2;
+    int order = memcmp(records[middle].hash, hash, sizeof(hash));
+
+    if (order == 0)
+    {
+      record = &records[middle];
+      break;
+    }
+    if (order < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if ((record == NULL) || (snapshot_order(record->productId) != productId))
+    return false;
+
+  // Expired since exported, look it up on-chain
+  exp_date = (time_t)snapshot_order(record->exp_date);
+  if ((exp_date != 0) && (time(NULL) >= exp_date))
+    return false;
+  found->done = true;
+  found->result = (int)snapshot_order(record->result);
+  found->exp_date = exp_date;
+  found->languages = snapshot_order(record->languages);
+  found->version_plat = snapshot_order(record->version_plat);
+  return true;
+}
+
+/***********************************************************************/
+/* snapshot_write: Write a snapshot (or filter) file, replacing it     */
+/*                 only once completely written                        */
+/*                                                                     */
+/*      Inputs: filename = full filename of the file                   */
+/*              data = the contents of the file                        */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/***********************************************************************/
+static int snapshot_write(const char* filename, const std::vector<ui8>& data)
+{
+  std::string temporary = std::string(filename) + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+
+  if (file == NULL)
+    return otherLicenseError;
+  if ((fwrite(data.data(), 1, data.size(), file) != data.size()) |
+      (fclose(file) != 0))
+  {
+    remove(temporary.c_str());
+    return otherLicenseError;
+  }
+#ifdef _WINDOWS
+  remove(filename);
+#endif
+  if (rename(temporary.c_str(), filename) != 0)
+  {
+    remove(temporary.c_str());
+    return otherLicenseError;
+  }
+  return 0;
+}
+
+/***********************************************************************/
+/* Global function definitions                                         */
+/***********************************************************************/
+
+/***********************************************************************/
+/* EthereumValidateActivation: validate a license hash with blockchain */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              network = the network of the call, NULL for defaults   */
+/*              deadline = the deadline and cancellation of the call,  */
+/*                         NULL to wait for the endpoints              */
+/*     Outputs: exp_date = expiration date of the activation (or 0)    */
+/*              languages = language flags for the file                */
+/*              version_plat = version and platform flags              */
+/*                                                                     */
+/*     Returns: the value of any license activation returned, timedOut */
+/*              if the deadline passed, cancelled if cancelled         */
+/*                                                                     */
+/*  Note: A valid activation is cached, see EthereumSetCacheTtl(). An  */
+/*        activation of a synced entity is answered from its index,    */
+/*        see EthereumStartSync(), or from a snapshot file of it, see  */
+/*        EthereumSetSnapshot().                                       */
+/*                                                                     */
+/***********************************************************************/
+int EthereumValidateActivation(ui64 entityId, ui64 productId,
+      char* hashId, char* infuraId, time_t* exp_date, ui64* languages,
+      ui64 *version_plat, const EthereumNetwork* network,
+      const EthereumDeadline* deadline)
+{
+  std::shared_ptr<ActivationFlight> flight;
+  char key[2 * 21 + 67 + ETHEREUM_URL_SIZE + 43 + 4];
+  ActivationFlight found;
+  SharedCacheSlot shared;
+  bool leader = false, revalidate, refresh;
+  int expired, negative;
+  ui64 head;
+
+  // Identical lookups (entity, product, hash and network) share one
+  //   request, and one cached result
+  snprintf(key, sizeof(key), "%llu:%llu:%s:%s:%s", entityId, productId,
+           hashId, network ? network->url : "",
+           network_activate_contract(network));
+
+  // The index of a synced entity (or a snapshot of it) answers from
+  //   memory
+  if (sync_find(entityId, productId, hashId, network, &found) ||
+      snapshot_find(entityId, productId, hashId, &found))
+  {
+    PRINTF("Synced activation %s\n", key);
+    if (exp_date)
+      *exp_date = found.exp_date;
+    if (languages)
+      *languages = found.languages;
+    if (version_plat)
+      *version_plat = found.version_plat;
+    return found.result;
+  }
+
+  // When polling, the chain head (read at most once per interval) keys
+  //   the cached results
+  head = chain_head(network, infuraId, deadline);
+  for (;;)
+  {
+    expired = deadline_check(deadline);
+    if (expired)
+      return expired;
+
+    // A valid result in the cache needs no request, one near its TTL
+    //   is validated again in the background if refreshing
+    if (activation_cache_find(key, false, head, &found, &refresh))
+    {
+      PRINTF("Cached activation %s\n", key);
+      if (refresh)
+        activation_revalidate(key, entityId, productId, hashId, infuraId,
+                              network, head);
+      flight = std::make_shared<ActivationFlight>(found);
+      break;
+    }
+
+    // Nor does an activation recently not found (or expired) on-chain
+    if (negative_cache_find(key, head, &negative))
+    {
+      PRINTF("Negative cached activation %s\n", key);
+      flight = std::make_shared<ActivationFlight>();
+      flight->done = true;
+      flight->result = negative;
+      break;
+    }
+
+    // So does a result of another process on this host
+    if (shared_cache_find(key, SHARED_ACTIVATION, &shared))
+    {
+      PRINTF("Shared activation %s\n", key);
+      found.done = true;
+      found.result = shared.result;
+      found.exp_date = (time_t)shared.values[0];
+      found.languages = shared.values[1];
+      found.version_plat = shared.values[2];
+      flight = std::make_shared<ActivationFlight>(found);
+      break;
+    }
+
+    // A result in the cache file answers at once, validating it again
+    //   in the background when older than the TTL
+    if (activation_file_find(key, &found, &revalidate))
+    {
+      PRINTF("Cache file activation %s\n", key);
+      if (revalidate)
+        activation_revalidate(key, entityId, productId, hashId, infuraId,
+                              network, head);
+      flight = std::make_shared<ActivationFlight>(found);
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(FlightLock);
+      std::map<std::string, std::shared_ptr<ActivationFlight> >::iterator
+        it = Flights.find(key);
+
+      if (it == Flights.end())
+      {
+        flight = std::make_shared<ActivationFlight>();
+        Flights[key] = flight;
+        leader = true;
+      }
+      else
+        flight = it->second;
+    }
+
+    // The first caller performs the lookup for all waiting callers
+    if (leader)
+    {
+      ActivationFlight result;
+      ui64 since = SyncRunning ? sync_block() : 0;
+
+      result.result = autolm_validate_activation(network, entityId,
+                        productId, hashId, infuraId, &result.exp_date,
+                        &result.languages, &result.version_plat,
+                        deadline);
+      result.bounded = (deadline != NULL);
+      result.block = head;
+      activation_cache_store(key, result);
+      sync_store(entityId, productId, hashId, network, result, since);
+
+      // Publish the result and wake the waiting callers
+      std::lock_guard<std::mutex> lock(FlightLock);
+      *flight = result;
+      flight->done = true;
+      Flights.erase(key);
+      FlightDone.notify_all();
+      break;
+    }
+
+    // Otherwise wait for the result of the request in flight, or
+    //   until this caller is cancelled or its deadline passes
+    {
+      std::unique_lock<std::mutex> lock(FlightLock);
+
+      while (!flight->done)
+      {
+        if (deadline == NULL)
+          FlightDone.wait(lock);
+        else
+        {
+          expired = deadline_check(deadline);
+          if (expired)
+            return expired;
+          FlightDone.wait_until(lock, (deadline->cancel == NULL) ?
+            deadline->at : std::min(deadline->at,
+              std::chrono::steady_clock::now() +
+              std::chrono::milliseconds(DEADLINE_POLL_MS)));
+        }
+      }
+      PRINTF("Coalesced activation lookup %s\n", key);
+    }
+
+    // The deadline (or cancel) of the first caller is not this caller's,
+    //   so look up again
+    if (!flight->bounded ||
+        ((flight->result != timedOut) && (flight->result != cancelled)))
+      break;
+  }
+
+  // The endpoints are failing fast, serve a result past its TTL
+  if ((flight->result == endpointUnavailable) &&
+      activation_cache_find(key, true, head, &found, &refresh))
+  {
+    if (refresh)
+      activation_revalidate(key, entityId, productId, hashId, infuraId,
+                            network, head);
+    flight = std::make_shared<ActivationFlight>(found);
+  }
+
+  if (exp_date)
+    *exp_date = flight->exp_date;
+  if (languages)
+    *languages = flight->languages;
+  if (version_plat)
+    *version_plat = flight->version_plat;
+  return flight->result;
+}
+
+/***********************************************************************/
+/* EthereumValidateActivations: validate many license hashes with the  */
+/*                              blockchain, in JSON-RPC batches        */
+/*                                                                     */
+/*      Inputs: activations = entityId, productId and hashId of each   */
+/*              count = the number of activations to validate          */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              deadline = the deadline and cancellation of the call,  */
+/*                         NULL to wait for the endpoints              */
+/*     Outputs: activations = result, exp_date, languages and          */
+/*                            version_plat of each activation          */
+/*                                                                     */
+/*     Returns: zero if all batches performed, otherwise error         */
+/*                                                                     */
+/***********************************************************************/
+int EthereumValidateActivations(EthereumActivation* activations,
+      int count, const char* infuraId, const EthereumNetwork* network,
+      const EthereumDeadline* deadline)
+{
+  int first, res = 0;
+
+  if ((activations == NULL) || (count <= 0) || (infuraId == NULL))
+    return otherLicenseError;
+
+  // Send the activations in batches of up to ETHEREUM_MAX_BATCH
+  for (first = 0; (first < count) && (res == 0);
+       first += ETHEREUM_MAX_BATCH)
+  {
+    int batch = count - first;
+    if (batch > ETHEREUM_MAX_BATCH)
+      batch = ETHEREUM_MAX_BATCH;
+    res = autolm_read_activations(network, infuraId, &activations[first],
+                                  batch, deadline);
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* EthereumValidateActivationsMulticall: validate many license hashes  */
+/*                  with Multicall3, one eth_call for many activations */
+/*                                                                     */
+/*      Inputs: activations = entityId, productId and hashId of each   */
+/*              count = the number of activations to validate          */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              deadline = the deadline and cancellation of the call,  */
+/*                         NULL to wait for the endpoints              */
+/*     Outputs: activations = result, exp_date, languages and          */
+/*                            version_plat of each activation          */
+/*                                                                     */
+/*     Returns: zero if all calls performed, otherwise error           */
+/*                                                                     */
+/***********************************************************************/
+int EthereumValidateActivationsMulticall(EthereumActivation* activations,
+      int count, const char* infuraId, const EthereumNetwork* network,
+      const EthereumDeadline* deadline)
+{
+  int first, res = 0;
+
+  if ((activations == NULL) || (count <= 0) || (infuraId == NULL))
+    return otherLicenseError;
+
+  // Aggregate up to ETHEREUM_MAX_MULTICALL activations per eth_call
+  for (first = 0; (first < count) && (res == 0);
+       first += ETHEREUM_MAX_MULTICALL)
+  {
+    int batch = count - first;
+    if (batch > ETHEREUM_MAX_MULTICALL)
+      batch = ETHEREUM_MAX_MULTICALL;
+    res = autolm_read_multicall(network, infuraId, &activations[first],
+                                batch, deadline);
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* EthereumAuthenticateFile: lookup file authenticity on blockchain    */
+/*                                                                     */
+/*      Inputs: hashId = file SHA256 checksum hex string to lookup     */
+/*              infuraId = Infura ProductId hex string used for access */
+/*              deadline = the deadline and cancellation of the call,  */
+/*                         NULL to wait for the endpoints              */
+/*     Outputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              releaseId = the product release index of file          */
+/*              languages = the 64 bit language flags of file          */
+/*              version = the version, 4 x 16 bits (X.X.X.X)           */
+/*              uri = the URI string pointing to the release file      */
+/*                    (ETHEREUM_URI_SIZE bytes, uriTooLong if longer)  */
+/*                                                                     */
+/*     Returns: the zero on success, negative on error                 */
+/*                                                                     */
+/***********************************************************************/
+int EthereumAuthenticateFile(const char* hashId,
+  const char* infuraId, ui64* entityId, ui64* productId,
+  ui64* releaseId, ui64* languages, ui64* version, char* uri,
+  const EthereumNetwork* network, const EthereumDeadline* deadline)
+{
+  size_t uriSize = ETHEREUM_URI_SIZE;
+
+  return EthereumAuthenticateFile(hashId, infuraId, entityId, productId,
+                                  releaseId, languages, version, uri,
+                                  &uriSize, network, deadline);
+}
+
+/***********************************************************************/
+/* EthereumAuthenticateFile: lookup file authenticity on blockchain    */
+/*                           with a URI of any length                  */
+/*                                                                     */
+/*      Inputs: hashId = file SHA256 checksum hex string to lookup     */
+/*              infuraId = Infura ProductId hex string used for access */
+/*              uriSize = the size of the uri buffer                   */
+/*              deadline = the deadline and cancellation of the call,  */
+/*                         NULL to wait for the endpoints              */
+/*     Outputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              releaseId = the product release index of file          */
+/*              languages = the 64 bit language flags of file          */
+/*              version = the version, 4 x 16 bits (X.X.X.X)           */
+/*              uri = the URI string pointing to the release file      */
+/*              uriSize = the size needed for the whole URI            */
+/*                                                                     */
+/*     Returns: the zero on success, uriTooLong if the URI did not fit */
+/*              (call again with uriSize bytes), otherwise error       */
+/*                                                                     */
+/***********************************************************************/
+int EthereumAuthenticateFile(const char* hashId,
+  const char* infuraId, ui64* entityId, ui64* productId,
+  ui64* releaseId, ui64* languages, ui64* version, char* uri,
+  size_t* uriSize, const EthereumNetwork* network,
+  const EthereumDeadline* deadline)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = CREATOR_STATUS_ID;
+  char key[67 + ETHEREUM_URL_SIZE + 43 + 3];
+  SharedCacheSlot shared;
+  size_t length;
+  ui32 ttl = CacheTtl;
+  bool keyed = (hashId != NULL) && (strlen(hashId) < 67);
+  ui64 head = 0;
+  int res;
+
+  // A release recently not found needs no request. A hash too long for
+  //   the key is not cached.
+  if (keyed)
+  {
+    snprintf(key, sizeof(key), "%s:%s:%s", hashId,
+             network ? network->url : "", network_creator_contract(network));
+    head = chain_head(network, infuraId, deadline);
+    if (negative_cache_find(std::string("release:") + key, head, &res))
+    {
+      PRINTF("Negative cached release %s\n", key);
+      if (entityId)
+        *entityId = 0;
+      if (productId)
+        *productId = 0;
+      if (releaseId)
+        *releaseId = 0;
+      if (languages)
+        *languages = 0;
+      if (version)
+        *version = 0;
+      if (uri && (*uriSize > 0))
+        uri[0] = '\0';
+      return res;
+    }
+  }
+
+  // Nor does a release authenticated by another process on this host,
+  //   the URI is returned as the provider would
+  if (keyed && (ttl != 0) &&
+      shared_cache_find(key, SHARED_RELEASE, &shared))
+  {
+    PRINTF("Shared release %s\n", key);
+    if (entityId)
+      *entityId = shared.values[0];
+    if (productId)
+      *productId = shared.values[1];
+    if (releaseId)
+      *releaseId = shared.values[2];
+    if (languages)
+      *languages = shared.values[3];
+    if (version)
+      *version = shared.values[4];
+    if (uri == NULL)
+      return shared.result;
+    if (*uriSize == 0)
+      return uriTooLong;
+    length = strlen(shared.uri);
+    strncpy(uri, shared.uri, *uriSize - 1);
+    uri[std::min(length, *uriSize - 1)] = '\0';
+    res = (length < *uriSize) ? shared.result : uriTooLong;
+    *uriSize = length + 1;
+    return res;
+  }
+
+  // Encode the function parameters as JSON paramters
+  encode_authenticate_json(funcId, hashId, jsonParams);
+  PRINTF("%s\n", jsonParams);
+
+  // productReleaseHashDetails(uint256) is in ImmutableProduct contract
+  char jsonDataAll[2048];
+  encode_eth_call_json(network_creator_contract(network), jsonParams,
+                       JsonRpcId++, jsonDataAll);
+  PRINTF("jsonData = %s\n", jsonDataAll);
+  res = autolm_read_authentication(network, infuraId, jsonDataAll,
+                    entityId, productId, releaseId, languages, version,
+                    uri, uriSize, deadline);
+
+  // Remember a release not found
+  if (keyed && (res == blockchainNotFound))
+  {
+    std::lock_guard<std::mutex> lock(CacheLock);
+
+    negative_cache_store(std::string("release:") + key, res, head);
+  }
+
+  // Share an authenticated release (with all of its URI)
+  if (keyed && (res == 0) && (ttl != 0) && uri && entityId && productId &&
+      releaseId && languages && version &&
+      (strlen(uri) < sizeof(shared.uri)))
+  {
+    std::lock_guard<std::mutex> lock(CacheLock);
+
+    memset(&shared, 0, sizeof(shared));
+    shared.kind = SHARED_RELEASE;
+    shared.fresh = (ui64)(time(NULL) + ttl);
+    shared.values[0] = *entityId;
+    shared.values[1] = *productId;
+    shared.values[2] = *releaseId;
+    shared.values[3] = *languages;
+    shared.values[4] = *version;
+    shared.result = res;
+    strcpy(shared.uri, uri);
+    shared_cache_store(key, &shared);
+  }
+  return res;
+}
+
+/***********************************************************************/
+/* EthereumValidateActivationAsync: validate a license hash with the   */
+/*                           blockchain without blocking the caller    */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              callback = function called with the activation result  */
+/*                         from the event loop thread (do not block)   */
+/*              context = caller data passed through to the callback   */
+/*                                                                     */
+/*     Returns: zero if the request is queued, otherwise error         */
+/*                                                                     */
+/***********************************************************************/
+int EthereumValidateActivationAsync(ui64 entityId, ui64 productId,
+      const char* hashId, const char* infuraId,
+      EthereumActivationCallback callback, void* context,
+      const EthereumNetwork* network)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = ACTIVATE_STATUS_ID;
+  char jsonDataAll[2048];
+
+  if ((hashId == NULL) || (infuraId == NULL) || (callback == NULL) ||
+      (strlen(hashId) >= sizeof(((EthereumActivation*)0)->hashId)))
+    return otherLicenseError;
+
+  AsyncTransfer* transfer = new AsyncTransfer();
+  transfer->activation.entityId = entityId;
+  transfer->activation.productId = productId;
+  strcpy(transfer->activation.hashId, hashId);
+  transfer->activationCallback = callback;
+  transfer->context = context;
+  if (network)
+    transfer->network = *network;
+
+  // Encode the eth_call request with a unique JSON-RPC id
+  encode_activate_json(funcId, entityId, productId,
+                       transfer->activation.hashId, jsonParams);
+  encode_eth_call_json(network_activate_contract(network), jsonParams,
+                       JsonRpcId++, jsonDataAll);
+  transfer->jsonData = jsonDataAll;
+  transfer->infuraId = infuraId;
+  return async_post_json(transfer);
+}
+
+/***********************************************************************/
+/* EthereumAuthenticateFileAsync: lookup file authenticity on the      */
+/*                           blockchain without blocking the caller    */
+/*                                                                     */
+/*      Inputs: hashId = file SHA256 checksum hex string to lookup     */
+/*              infuraId = Infura ProductId hex string used for access */
+/*              callback = function called with the release result     */
+/*                         from the event loop thread (do not block)   */
+/*              context = caller data passed through to the callback   */
+/*                                                                     */
+/*     Returns: zero if the request is queued, otherwise error         */
+/*                                                                     */
+/***********************************************************************/
+int EthereumAuthenticateFileAsync(const char* hashId, const char* infuraId,
+      EthereumReleaseCallback callback, void* context,
+      const EthereumNetwork* network)
+{
+  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
+  char funcId[] = CREATOR_STATUS_ID;
+  char jsonDataAll[2048];
+
+  if ((hashId == NULL) || (infuraId == NULL) || (callback == NULL) ||
+      (strlen(hashId) >= sizeof(((EthereumRelease*)0)->hashId)))
+    return otherLicenseError;
+
+  AsyncTransfer* transfer = new AsyncTransfer();
+  strcpy(transfer->release.hashId, hashId);
+  transfer->releaseCallback = callback;
+  transfer->context = context;
+  if (network)
+    transfer->network = *network;
+
+  // Encode the eth_call request with a unique JSON-RPC id
+  encode_authenticate_json(funcId, hashId, jsonParams);
+  encode_eth_call_json(network_creator_contract(network), jsonParams,
+                       JsonRpcId++, jsonDataAll);
+  transfer->jsonData = jsonDataAll;
+  transfer->infuraId = infuraId;
+  return async_post_json(transfer);
+}
+
+/***********************************************************************/
+/* future_activation: Complete the promise of a future activation      */
+/*                                                                     */
+/*      Inputs: activation = the activation result                     */
+/*              context = the std::promise of the future               */
+/*                                                                     */
+/***********************************************************************/
+static void future_activation(const EthereumActivation* activation,
+                              void* context)
+{
+  std::promise<EthereumActivation>* promise =
+    (std::promise<EthereumActivation>*)context;
+
+  promise->set_value(*activation);
+  delete promise;
+}
+
+/***********************************************************************/
+/* future_release: Complete the promise of a future file release       */
+/*                                                                     */
+/*      Inputs: release = the file release result                      */
+/*              context = the std::promise of the future               */
+/*                                                                     */
+/***********************************************************************/
+static void future_release(const EthereumRelease* release, void* context)
+{
+  std::promise<EthereumRelease>* promise =
+    (std::promise<EthereumRelease>*)context;
+
+  promise->set_value(*release);
+  delete promise;
+}
+
+/***********************************************************************/
+/* EthereumValidateActivationAsync: validate a license hash with the   */
+/*                                  blockchain as a std::future        */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*              infuraId = the Infura ProductId to use for access      */
+/*                                                                     */
+/*     Returns: the future activation, result is the AutoLmResponse    */
+/*                                                                     */
+/***********************************************************************/
+std::future<EthereumActivation> EthereumValidateActivationAsync(
+      ui64 entityId, ui64 productId, const char* hashId,
+      const char* infuraId, const EthereumNetwork* network)
+{
+  std::promise<EthereumActivation>* promise =
+    new std::promise<EthereumActivation>();
+  std::future<EthereumActivation> future = promise->get_future();
+  int res;
+
+  res = EthereumValidateActivationAsync(entityId, productId, hashId,
+                                        infuraId, future_activation,
+                                        promise, network);
+  if (res != 0)
+  {
+    // Not queued, the future is ready with the error
+    EthereumActivation activation;
+    memset(&activation, 0, sizeof(activation));
+    activation.entityId = entityId;
+    activation.productId = productId;
+    if (hashId && (strlen(hashId) < sizeof(activation.hashId)))
+      strcpy(activation.hashId, hashId);
+    activation.result = res;
+    future_activation(&activation, promise);
+  }
+  return future;
+}
+
+/***********************************************************************/
+/* EthereumAuthenticateFileAsync: lookup file authenticity on the      */
+/*                                blockchain as a std::future          */
+/*                                                                     */
+/*      Inputs: hashId = file SHA256 checksum hex string to lookup     */
+/*              infuraId = Infura ProductId hex string used for access */
+/*                                                                     */
+/*     Returns: the future release, result is zero if found            */
+/*                                                                     */
+/***********************************************************************/
+std::future<EthereumRelease> EthereumAuthenticateFileAsync(
+      const char* hashId, const char* infuraId,
+      const EthereumNetwork* network)
+{
+  std::promise<EthereumRelease>* promise =
+    new std::promise<EthereumRelease>();
+  std::future<EthereumRelease> future = promise->get_future();
+  int res;
+
+  res = EthereumAuthenticateFileAsync(hashId, infuraId, future_release,
+                                      promise, network);
+  if (res != 0)
+  {
+    // Not queued, the future is ready with the error
+    EthereumRelease release;
+    memset(&release, 0, sizeof(release));
+    if (hashId && (strlen(hashId) < sizeof(release.hashId)))
+      strcpy(release.hashId, hashId);
+    release.result = res;
+    future_release(&release, promise);
+  }
+  return future;
+}
+
+/***********************************************************************/
+/* EthereumSetCacheTtl: set how long valid activations are cached      */
+/*                                                                     */
+/*      Inputs: seconds = the longest time a result is cached, or zero */
+/*                        to disable the cache                         */
+/*                                                                     */
+/*  Note: A result is never cached past its on-chain expiration date.  */
+/*        The default is ETHEREUM_CACHE_TTL_SECONDS.                   */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetCacheTtl(ui32 seconds)
+{
+  CacheTtl = seconds;
+  if (seconds == 0)
+    EthereumClearCache();
+}
+
+/***********************************************************************/
+/* EthereumSetCacheRefresh: validate cached activations again in the   */
+/*                          background before the TTL                  */
+/*                                                                     */
+/*      Inputs: percent = percent of the TTL after which a cached      */
+/*                        result is validated again (while it is still */
+/*                        served), or zero to stop refreshing          */
+/*                                                                     */
+/*  Note: While refreshing, a result past its TTL is served (and       */
+/*        validated again) for up to ETHEREUM_CACHE_GRACE_SECONDS,     */
+/*        so a caller never waits for a license validated before. It   */
+/*        is never served past its on-chain expiration date.           */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetCacheRefresh(ui32 percent)
+{
+  CacheRefresh = std::min(percent, (ui32)100);
+}
+
+/***********************************************************************/
+/* EthereumSetBlockPolling: key cached results by the chain head,      */
+/*                          polled with eth_blockNumber                */
+/*                                                                     */
+/*      Inputs: intervalMs = the least time between polls of each      */
+/*                           network, or zero to stop polling          */
+/*                                                                     */
+/*  Note: A cached activation is then fresh until the chain head moves */
+/*        (rather than until the TTL), and a cached activation or      */
+/*        release not found until the chain head moves or its TTL.     */
+/*        Only the lookups made after the head moved are validated     */
+/*        again, in the background if refreshing. The TTL applies      */
+/*        while the block number is unknown.                           */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetBlockPolling(ui32 intervalMs)
+{
+  BlockPollMs = intervalMs;
+
+  std::lock_guard<std::mutex> lock(HeadLock);
+  ChainHeads.clear();
+}
+
+/***********************************************************************/
+/* EthereumSubscribeActivations: evict cached activations named in the */
+/*                               logs of the activate contract         */
+/*                                                                     */
+/*      Inputs: url = the WebSocket URL of the node (ws:// or wss://), */
+/*                    including any provider (Infura) Id               */
+/*              network = the network of the contract, NULL for the    */
+/*                        defaults                                     */
+/*                                                                     */
+/*     Returns: zero if subscribing, otherwise otherLicenseError (if   */
+/*              already subscribed or WebSockets are not supported)    */
+/*                                                                     */
+/*  Note: The subscription (eth_subscribe "logs") is kept by a         */
+/*        background thread, reconnecting with a backoff. A cached     */
+/*        activation whose hash is in a log is forgotten, or validated */
+/*        again on its next lookup if refreshing. Every cached result  */
+/*        is forgotten when subscribed again, logs may have been       */
+/*        missed while disconnected.                                   */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSubscribeActivations(const char* url,
+                                 const EthereumNetwork* network)
+{
+#ifdef ETHEREUM_WEBSOCKET
+  std::lock_guard<std::mutex> lock(SubscribeLock);
+
+  if ((url == NULL) || SubscribeRunning ||
+      ((strncmp(url, "ws://", 5) != 0) && (strncmp(url, "wss://", 6) != 0)))
+    return otherLicenseError;
+  if (SubscribeThread.joinable())
+    SubscribeThread.join();
+
+  SubscribeRunning = true;
+  SubscribeThread = std::thread(subscribe_loop, std::string(url),
+                      std::string(network_activate_contract(network)));
+  return 0;
+#else
+  (void)url;
+  (void)network;
+  return otherLicenseError;
+#endif
+}
+
+/***********************************************************************/
+/* EthereumUnsubscribeActivations: stop the subscription to the logs   */
+/*                                 of the activate contract            */
+/*                                                                     */
+/***********************************************************************/
+void EthereumUnsubscribeActivations(void)
+{
+  std::lock_guard<std::mutex> lock(SubscribeLock);
+
+  SubscribeRunning = false;
+  if (SubscribeThread.joinable())
+    SubscribeThread.join();
+}
+
+/***********************************************************************/
+/* EthereumStartSync: keep a local index of the activations of an      */
+/*                    entity, synced with eth_getLogs                  */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) to sync          */
+/*              productIds = the product Ids of the entity to sync     */
+/*              count = the number of product Ids                      */
+/*              fromBlock = the first block to backfill (for example   */
+/*                          of the first activation, or the deploy     */
+/*                          block of the activate contract for a       */
+/*                          complete index), zero to follow from the   */
+/*                          chain head                                 */
+/*              infuraId = the Infura ProductId to use for access      */
+/*              network = the network of the lookups, NULL for the     */
+/*                        defaults                                     */
+/*              intervalMs = milliseconds between syncs                */
+/*                                                                     */
+/*     Returns: zero if syncing, otherwise otherLicenseError (if       */
+/*              already syncing or the inputs are invalid)             */
+/*                                                                     */
+/*  Note: A background thread reads the logs of the activate contract, */
+/*        a block range at a time, backfilling and then following the  */
+/*        chain head. The activation hashes named in the logs of the   */
+/*        entity (and any activation validated by a lookup) are        */
+/*        validated and kept in the index, and validated again when a  */
+/*        later log names them. While synced, an indexed activation is */
+/*        answered from memory, other lookups are sent to the node as  */
+/*        before. The index is best-effort: a log is of the entity if  */
+/*        its topic ETHEREUM_SYNC_ENTITY_TOPIC is the Entity Id, so an */
+/*        activation the index misses is only looked up on-chain.      */
+/*                                                                     */
+/***********************************************************************/
+int EthereumStartSync(ui64 entityId, const ui64* productIds, int count,
+                      ui64 fromBlock, const char* infuraId,
+                      const EthereumNetwork* network, ui32 intervalMs)
+{
+  std::lock_guard<std::mutex> lock(SyncLock);
+  EthereumNetwork copy;
+
+  if ((productIds == NULL) || (count <= 0) || (infuraId == NULL) ||
+      (intervalMs == 0) || SyncRunning)
+    return otherLicenseError;
+  if (SyncThread.joinable())
+    SyncThread.join();
+
+  {
+    std::lock_guard<std::mutex> indexLock(SyncIndexLock);
+
+    SyncIndex.clear();
+    SyncProducts.assign(productIds, productIds + count);
+    SyncUrl = network ? network->url : "";
+    SyncEntity = entityId;
+    SyncInterval = intervalMs;
+    SyncBlock = 0;
+    SyncCurrent = false;
+    SyncComplete = false;
+    memset(SyncLogged, 0, sizeof(SyncLogged));
+
+    // A filter built from the index before is no longer kept current
+    std::lock_guard<std::mutex> filterLock(FilterLock);
+    FilterSynced = false;
+  }
+  memset(&copy, 0, sizeof(copy));
+  if (network)
+    copy = *network;
+  SyncRunning = true;
+  SyncThread = std::thread(sync_loop, entityId, SyncProducts, fromBlock,
+                           intervalMs, std::string(infuraId), copy,
+                           network != NULL);
+  return 0;
+}
+
+/***********************************************************************/
+/* EthereumStopSync: stop the sync and forget the index                */
+/*                                                                     */
+/***********************************************************************/
+void EthereumStopSync(void)
+{
+  std::lock_guard<std::mutex> lock(SyncLock);
+
+  SyncRunning = false;
+  if (SyncThread.joinable())
+    SyncThread.join();
+
+  std::lock_guard<std::mutex> indexLock(SyncIndexLock);
+  SyncIndex.clear();
+  SyncCurrent = false;
+}
+
+/***********************************************************************/
+/* EthereumExportSnapshot: write the synced activations of the entity  */
+/*                         to a snapshot file                          */
+/*                                                                     */
+/*      Inputs: filename = full filename of the snapshot file          */
+/*              key = the HMAC key of the file, shared with the nodes  */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*     Outputs: count = the number of activations written, or NULL     */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (if the   */
+/*              index is not synced or the file cannot be written)     */
+/*                                                                     */
+/*  Note: See EthereumStartSync(), the file is written once the index  */
+/*        is synced to the chain head                                  */
+/*                                                                     */
+/***********************************************************************/
+int EthereumExportSnapshot(const char* filename, const ui8* key,
+                           ui32 keyLength, ui32* count)
+{
+  std::map<std::string, SyncedActivation>::iterator it;
+  std::vector<ui8> data;
+  SnapshotHeader header;
+  SnapshotRecord record;
+  ui8 mac[SHAHASHBYTES];
+
+  if ((filename == NULL) || (keyLength > 64) ||
+      ((key == NULL) && (keyLength > 0)))
+    return otherLicenseError;
+
+  // The index, in order of hash, after the header
+  {
+    std::lock_guard<std::mutex> lock(SyncIndexLock);
+
+    if (!SyncRunning || !SyncCurrent)
+      return otherLicenseError;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.entityId = snapshot_order(SyncEntity);
+    header.block = snapshot_order(SyncBlock);
+    header.created = snapshot_order((ui64)time(NULL));
+    header.records = snapshot_order(SyncIndex.size());
+    data.insert(data.end(), (const ui8*)&header,
+                (const ui8*)&header + sizeof(header));
+    for (it = SyncIndex.begin(); it != SyncIndex.end(); ++it)
+    {
+      memset(&record, 0, sizeof(record));
+      snapshot_hash(it->first.c_str(), record.hash);
+      record.productId = snapshot_order(it->second.productId);
+      record.exp_date = snapshot_order((ui64)it->second.found.exp_date);
+      record.languages = snapshot_order(it->second.found.languages);
+      record.version_plat = snapshot_order(it->second.found.version_plat);
+      record.result = snapshot_order((ui64)it->second.found.result);
+      data.insert(data.end(), (const ui8*)&record,
+                  (const ui8*)&record + sizeof(record));
+    }
+    if (count)
+      *count = (ui32)SyncIndex.size();
+  }
+  cache_mac(key, keyLength, data.data(), data.size(), mac);
+  data.insert(data.end(), mac, mac + sizeof(mac));
+
+  return snapshot_write(filename, data);
+}
+
+/***********************************************************************/
+/* EthereumSetSnapshot: answer activations from a snapshot file of an  */
+/*                      entity, without the blockchain                 */
+/*                                                                     */
+/*      Inputs: filename = full filename of the snapshot file, or NULL */
+/*                         to close it                                 */
+/*              key = the HMAC key the file was exported with          */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (if the   */
+/*              file cannot be read or is not authentic)               */
+/*                                                                     */
+/*  Note: The file is mapped into memory and each lookup of an         */
+/*        activation of the entity is a binary search of its records.  */
+/*        An activation not in the file (or expired since exported) is */
+/*        looked up on-chain as before.                                */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSetSnapshot(const char* filename, const ui8* key,
+                        ui32 keyLength)
+{
+  std::lock_guard<std::mutex> lock(SnapshotLock);
+  const SnapshotHeader* header;
+  const SnapshotRecord* records;
+  ui8 mac[SHAHASHBYTES], differ = 0;
+  size_t size = 0;
+  ui64 count, i;
+
+  snapshot_close();
+  if (filename == NULL)
+    return 0;
+  if ((keyLength > 64) || ((key == NULL) && (keyLength > 0)))
+    return otherLicenseError;
+
+#ifdef ETHEREUM_PRIVATE_FILES
+  struct stat st;
+  void* map;
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return otherLicenseError;
+  if ((fstat(fd, &st) != 0) ||
+      ((size_t)st.st_size < sizeof(SnapshotHeader) + SHAHASHBYTES))
+  {
+    close(fd);
+    return otherLicenseError;
+  }
+  size = (size_t)st.st_size;
+  map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return otherLicenseError;
+  SnapshotMap = (ui8*)map;
+#else
+  FILE* file = fopen(filename, "rb");
+
+  if (file == NULL)
+    return otherLicenseError;
+  if ((fseek(file, 0, SEEK_END) == 0) && (ftell(file) > 0))
+    size = (size_t)ftell(file);
+  if ((size < sizeof(SnapshotHeader) + SHAHASHBYTES) ||
+      (fseek(file, 0, SEEK_SET) != 0) ||
+      ((SnapshotMap = (ui8*)malloc(size)) == NULL) ||
+      (fread(SnapshotMap, 1, size, file) != size))
+  {
+    fclose(file);
+    free(SnapshotMap);
+    SnapshotMap = NULL;
+    return otherLicenseError;
+  }
+  fclose(file);
+#endif
+  SnapshotSize = size;
+
+  // Only a complete, authentic file of sorted records is used
+  header = (const SnapshotHeader*)SnapshotMap;
+  records = (const SnapshotRecord*)(SnapshotMap + sizeof(SnapshotHeader));
+  count = snapshot_order(header->records);
+  if ((memcmp(header->magic, SNAPSHOT_MAGIC, 8) != 0) ||
+      (count != (size - sizeof(SnapshotHeader) - SHAHASHBYTES) /
+                sizeof(SnapshotRecord)) ||
+      (size != sizeof(SnapshotHeader) + count * sizeof(SnapshotRecord) +
+               SHAHASHBYTES))
+  {
+    snapshot_close();
+    return otherLicenseError;
+  }
+  cache_mac(key, keyLength, SnapshotMap, size - SHAHASHBYTES, mac);
+  for (i = 0; i < SHAHASHBYTES; i++)
+    differ |= mac[i] ^ SnapshotMap[size - SHAHASHBYTES + i];
+  for (i = 1; (differ == 0) && (i < count); i++)
+    if (memcmp(records[i - 1].hash, records[i].hash,
+               sizeof(records[i].hash)) >= 0)
+      differ = 1;
+  if (differ != 0)
+  {
+    PRINTF("Snapshot %s not authentic\n", filename);
+    snapshot_close();
+    return otherLicenseError;
+  }
+  PRINTF("Snapshot of entity %llu, %llu activations at block %llu\n",
+         snapshot_order(header->entityId), count,
+         snapshot_order(header->block));
+  return 0;
+}
+
+/***********************************************************************/
+/* EthereumBuildFilter: build a Bloom filter of the valid activations  */
+/*                      of the synced entity                           */
+/*                                                                     */
+/*      Inputs: bitsPerActivation = the bits of the filter for each    */
+/*                                  activation, 10 for about 1% false  */
+/*                                  positives                          */
+/*              maxAgeSeconds = longest time since last synced that an */
+/*                              activation not in the filter is not    */
+/*                              valid, see EthereumSetFilter()         */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (if the   */
+/*              index is not synced, or was not backfilled from the    */
+/*              deploy block of the activate contract)                 */
+/*                                                                     */
+/*  Note: The filter replaces any filter set, see EthereumSetFilter(). */
+/*        Only an index backfilled completely holds every activation,  */
+/*        so start the sync at (or before) the deploy block. While     */
+/*        synced, activations validated later are added and the filter */
+/*        stays current.                                               */
+/*                                                                     */
+/***********************************************************************/
+int EthereumBuildFilter(ui32 bitsPerActivation, ui32 maxAgeSeconds)
+{
+  std::map<std::string, SyncedActivation>::iterator it;
+  std::vector<ui64> bits;
+  ui64 seed, first, step, bit;
+  ui32 hashes;
+  time_t now = time(NULL);
+
+  if ((bitsPerActivation == 0) || (bitsPerActivation > 64))
+    return otherLicenseError;
+
+  // About ln(2) bits set for each bit per activation is the fewest
+  //   false positives
+  hashes = (bitsPerActivation * 693 + 500) / 1000;
+  if (hashes < 1)
+    hashes = 1;
+  else if (hashes > FILTER_HASHES_MAX)
+    hashes = FILTER_HASHES_MAX;
+  {
+    std::lock_guard<std::mutex> lock(JitterLock);
+    seed = ((ui64)JitterRandom() << 32) ^ JitterRandom();
+  }
+
+  std::lock_guard<std::mutex> lock(SyncIndexLock);
+  if (!SyncRunning || !SyncCurrent || !SyncComplete)
+    return otherLicenseError;
+  bits.resize((std::max<size_t>(SyncIndex.size(), 1) * bitsPerActivation +
+               63) / 64);
+  for (it = SyncIndex.begin(); it != SyncIndex.end(); ++it)
+  {
+    if (((it->second.found.exp_date != 0) &&
+         (now >= it->second.found.exp_date)) ||
+        !filter_element(SyncEntity, it->second.productId, it->first, seed,
+                        &first, &step))
+      continue;
+    for (ui32 i = 0; i < hashes; i++)
+    {
+      bit = (first + i * step) % (bits.size() * 64);
+      bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+  }
+
+  std::lock_guard<std::mutex> filterLock(FilterLock);
+  FilterBits.swap(bits);
+  FilterProducts = SyncProducts;
+  FilterEntity = SyncEntity;
+  FilterBlock = SyncBlock;
+  FilterCreated = (ui64)now;
+  FilterHashes = hashes;
+  FilterSeed = seed;
+  FilterMaxAge = maxAgeSeconds;
+  FilterSynced = true;
+  PRINTF("Filter of %u activations, %u bits\n", (ui32)SyncIndex.size(),
+         (ui32)(FilterBits.size() * 64));
+  return 0;
+}
+
+/***********************************************************************/
+/* EthereumExportFilter: write the activation filter to a file, for    */
+/*                       services to download                          */
+/*                                                                     */
+/*      Inputs: filename = full filename of the filter file            */
+/*              key = the HMAC key of the file, shared with services   */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (if no    */
+/*              filter or the file cannot be written)                  */
+/*                                                                     */
+/***********************************************************************/
+int EthereumExportFilter(const char* filename, const ui8* key,
+                         ui32 keyLength)
+{
+  std::vector<ui8> data;
+  FilterHeader header;
+  ui8 mac[SHAHASHBYTES];
+  ui64 word;
+
+  if ((filename == NULL) || (keyLength > 64) ||
+      ((key == NULL) && (keyLength > 0)))
+    return otherLicenseError;
+
+  {
+    std::lock_guard<std::mutex> lock(FilterLock);
+
+    if (FilterBits.empty())
+      return otherLicenseError;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILTER_MAGIC, 8);
+    header.entityId = snapshot_order(FilterEntity);
+    header.block = snapshot_order(FilterBlock);
+    header.created = snapshot_order(FilterCreated);
+    header.products = snapshot_order((ui64)FilterProducts.size());
+    header.bits = snapshot_order(FilterBits.size() * 64);
+    header.hashes = snapshot_order(FilterHashes);
+    header.seed = snapshot_order(FilterSeed);
+    data.insert(data.end(), (const ui8*)&header,
+                (const ui8*)&header + sizeof(header));
+    for (size_t i = 0; i < FilterProducts.size(); i++)
+    {
+      word = snapshot_order(FilterProducts[i]);
+      data.insert(data.end(), (const ui8*)&word,
+                  (const ui8*)&word + sizeof(word));
+    }
+    for (size_t i = 0; i < FilterBits.size(); i++)
+    {
+      word = snapshot_order(FilterBits[i]);
+      data.insert(data.end(), (const ui8*)&word,
+                  (const ui8*)&word + sizeof(word));
+    }
+  }
+  cache_mac(key, keyLength, data.data(), data.size(), mac);
+  data.insert(data.end(), mac, mac + sizeof(mac));
+  return snapshot_write(filename, data);
+}
+
+/***********************************************************************/
+/* EthereumSetFilter: reject activations not in a filter file of the   */
+/*                    valid activations of an entity                   */
+/*                                                                     */
+/*      Inputs: filename = full filename of the filter file, or NULL   */
+/*                         to remove the filter                        */
+/*              key = the HMAC key the file was exported with          */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*              maxAgeSeconds = longest time since the filter was      */
+/*                              built that an activation not in it is  */
+/*                              not valid, zero for never              */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (if the   */
+/*              file cannot be read or is not authentic)               */
+/*                                                                     */
+/*  Note: See EthereumFilterActivation(). An activation purchased      */
+/*        after the filter was built is not in it, so once older than  */
+/*        maxAgeSeconds an activation not in it is sent to the node.   */
+/*        Download (or build) the filter again often.                  */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSetFilter(const char* filename, const ui8* key, ui32 keyLength,
+                      ui32 maxAgeSeconds)
+{
+  const FilterHeader* header;
+  std::vector<ui8> data;
+  std::vector<ui64> bits, products;
+  ui8 mac[SHAHASHBYTES], differ = 0;
+  ui64 count = 0, hashes = 0, listed = 0, word;
+  size_t offset;
+  FILE* file;
+  long size;
+
+  {
+    std::lock_guard<std::mutex> lock(FilterLock);
+    FilterBits.clear();
+    FilterProducts.clear();
+    FilterSynced = false;
+  }
+  if (filename == NULL)
+    return 0;
+  if ((keyLength > 64) || ((key == NULL) && (keyLength > 0)))
+    return otherLicenseError;
+
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return otherLicenseError;
+  if ((fseek(file, 0, SEEK_END) != 0) || ((size = ftell(file)) <= 0) ||
+      (fseek(file, 0, SEEK_SET) != 0))
+    size = 0;
+  data.resize((size_t)size);
+  if ((size < (long)(sizeof(FilterHeader) + SHAHASHBYTES)) ||
+      (fread(data.data(), 1, data.size(), file) != data.size()))
+  {
+    fclose(file);
+    return otherLicenseError;
+  }
+  fclose(file);
+
+  // Only a complete, authentic filter is used
+  header = (const FilterHeader*)data.data();
+  if (memcmp(header->magic, FILTER_MAGIC, 8) == 0)
+  {
+    count = snapshot_order(header->bits) / 64;
+    hashes = snapshot_order(header->hashes);
+    listed = snapshot_order(header->products);
+  }
+  if ((count == 0) || (snapshot_order(header->bits) % 64 != 0) ||
+      (hashes == 0) || (hashes > FILTER_HASHES_MAX) ||
+      (listed == 0) || (listed > FILTER_PRODUCTS_MAX) ||
+      (count > (data.size() - sizeof(FilterHeader) - SHAHASHBYTES) / 8) ||
+      (data.size() != sizeof(FilterHeader) + (listed + count) * 8 +
+                      SHAHASHBYTES))
+    return otherLicenseError;
+  cache_mac(key, keyLength, data.data(), data.size() - SHAHASHBYTES, mac);
+  for (int i = 0; i < SHAHASHBYTES; i++)
+    differ |= mac[i] ^ data[data.size() - SHAHASHBYTES + i];
+  if (differ != 0)
+  {
+    PRINTF("Filter %s not authentic\n", filename);
+    return otherLicenseError;
+  }
+  offset = sizeof(FilterHeader);
+  products.resize(listed);
+  for (ui64 i = 0; i < listed; i++, offset += 8)
+  {
+    memcpy(&word, &data[offset], sizeof(word));
+    products[i] = snapshot_order(word);
+  }
+  bits.resize(count);
+  for (ui64 i = 0; i < count; i++, offset += 8)
+  {
+    memcpy(&word, &data[offset], sizeof(word));
+    bits[i] = snapshot_order(word);
+  }
+
+  std::lock_guard<std::mutex> lock(FilterLock);
+  FilterBits.swap(bits);
+  FilterProducts.swap(products);
+  FilterEntity = snapshot_order(header->entityId);
+  FilterBlock = snapshot_order(header->block);
+  FilterCreated = snapshot_order(header->created);
+  FilterHashes = (ui32)hashes;
+  FilterSeed = snapshot_order(header->seed);
+  FilterMaxAge = maxAgeSeconds;
+  PRINTF("Filter of entity %llu, %llu bits at block %llu\n", FilterEntity,
+         count * 64, FilterBlock);
+  return 0;
+}
+
+/***********************************************************************/
+/* EthereumFilterActivation: check an activation against the filter    */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to check   */
+/*                                                                     */
+/*     Returns: false if the activation is not valid (not in the       */
+/*              filter of the entity and product), true if it may be   */
+/*              valid or the filter cannot tell                        */
+/*                                                                     */
+/*  Note: Only a filter of the product younger than its maximum age    */
+/*        tells, an older filter may miss an activation purchased      */
+/*        since it was built.                                          */
+/*                                                                     */
+/***********************************************************************/
+bool EthereumFilterActivation(ui64 entityId, ui64 productId,
+                              const char* hashId)
+{
+  ui64 first, step, bit, now = (ui64)time(NULL);
+  std::string word;
+
+  if ((hashId == NULL) || !hash_word(hashId, strlen(hashId), &word))
+    return true;
+
+  std::lock_guard<std::mutex> lock(FilterLock);
+  if (FilterBits.empty() || (entityId != FilterEntity) ||
+      (std::find(FilterProducts.begin(), FilterProducts.end(),
+                 productId) == FilterProducts.end()) ||
+      (FilterCreated == 0) || (now >= FilterCreated + FilterMaxAge) ||
+      !filter_element(entityId, productId, word, FilterSeed, &first, &step))
+    return true;
+  for (ui32 i = 0; i < FilterHashes; i++)
+  {
+    bit = (first + i * step) % (FilterBits.size() * 64);
+    if ((FilterBits[bit / 64] & (1ULL << (bit % 64))) == 0)
+      return false;
+  }
+  return true;
+}
+
+/***********************************************************************/
+/* EthereumFilterAdd: add an activation to the filter, for example     */
+/*                    after a purchase                                 */
+/*                                                                     */
+/*      Inputs: entityId = the Entity Id (creator id) of application   */
+/*              productId = the product Id of the application          */
+/*              hashId = license activation hash identifier to add     */
+/*                                                                     */
+/*  Note: The activation is then sent to the node, not rejected by the */
+/*        filter built before it was purchased.                        */
+/*                                                                     */
+/***********************************************************************/
+void EthereumFilterAdd(ui64 entityId, ui64 productId, const char* hashId)
+{
+  std::string word;
+
+  if ((hashId != NULL) && hash_word(hashId, strlen(hashId), &word))
+    filter_add(entityId, productId, word);
+}
+
+/***********************************************************************/
+/* EthereumClearCache: forget every cached activation, for example     */
+/*                     after a purchase                                */
+/*                                                                     */
+/***********************************************************************/
+void EthereumClearCache(void)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  ActivationCache.clear();
+}
+
+/***********************************************************************/
+/* EthereumSetNegativeCacheTtl: set how long activations not found (or */
+/*                              expired) and releases not found are    */
+/*                              cached                                 */
+/*                                                                     */
+/*      Inputs: seconds = the longest time a result is cached, or zero */
+/*                        to disable the negative cache                */
+/*                                                                     */
+/*  Note: The default is ETHEREUM_NEGATIVE_TTL_SECONDS                 */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetNegativeCacheTtl(ui32 seconds)
+{
+  NegativeTtl = seconds;
+  if (seconds == 0)
+    EthereumClearNegativeCache();
+}
+
+/***********************************************************************/
+/* EthereumClearNegativeCache: forget every activation not found (or   */
+/*                             expired) and release not found, for     */
+/*                             example after a purchase                */
+/*                                                                     */
+/***********************************************************************/
+void EthereumClearNegativeCache(void)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  NegativeCache.clear();
+}
+
+/***********************************************************************/
+/* EthereumSetCacheFile: keep valid activations in a file, answering   */
+/*                       at startup and while the endpoints are down   */
+/*                                                                     */
+/*      Inputs: filename = the cache file, created if missing, or NULL */
+/*                         to close the cache file                     */
+/*              key = the secret key of the record HMAC                */
+/*              keyLength = the length of the key (up to 64 bytes)     */
+/*              graceSeconds = longest time a result is answered from  */
+/*                             the file without validating it again    */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: Records that fail the HMAC (tampered or written with another */
+/*        key) are ignored. A result is never answered past its        */
+/*        on-chain expiration date.                                    */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSetCacheFile(const char* filename, const ui8* key,
+                         ui32 keyLength, ui32 graceSeconds)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  cache_file_close();
+  if (filename == NULL)
+    return 0;
+  if ((filename[0] == 0) || (key == NULL) || (keyLength == 0) ||
+      (keyLength > sizeof(CacheFileKey)))
+    return otherLicenseError;
+
+  memcpy(CacheFileKey, key, keyLength);
+  CacheFileKeyLength = keyLength;
+  CacheFileGrace = graceSeconds;
+  CacheFileName = filename;
+  return cache_file_open();
+}
+
+/***********************************************************************/
+/* EthereumSetSharedCache: share valid activations and authenticated   */
+/*                         releases with every process on this host    */
+/*                                                                     */
+/*      Inputs: name = the POSIX shared memory name ("/name"), created */
+/*                     if missing, or NULL to stop sharing             */
+/*              key = the secret key of the slot HMAC, the same in     */
+/*                    every process that shares results                */
+/*              keyLength = the length of the key (up to 64 bytes)     */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError (and if   */
+/*              shared memory is not supported)                        */
+/*                                                                     */
+/*  Note: Results are read without locks (a sequence lock per slot).   */
+/*        Slots that fail the HMAC are ignored. Results are shared     */
+/*        for the TTL, see EthereumSetCacheTtl().                      */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSetSharedCache(const char* name, const ui8* key,
+                           ui32 keyLength)
+{
+  std::lock_guard<std::mutex> lock(CacheLock);
+
+  shared_cache_close();
+  if (name == NULL)
+    return 0;
+  if ((name[0] == 0) || (key == NULL) || (keyLength == 0) ||
+      (keyLength > sizeof(SharedCacheKey)))
+    return otherLicenseError;
+
+  memcpy(SharedCacheKey, key, keyLength);
+  SharedCacheKeyLength = keyLength;
+#ifdef ETHEREUM_SHARED_CACHE
+  return shared_cache_open(name);
+#else
+  return otherLicenseError;
 #endif
+}
 
-  /* Post json data */
-  curl_easy_setopt(easy, CURLOPT_POSTFIELDS, jsonData);
-  unsigned int jsonDataLength = (int)strlen(jsonData);
-  PRINTF("CURLOPT_POSTFIELDSIZE set to jsonDataLength = %d\n",
-    jsonDataLength);
-  /* set the size of the postfields data */
-  curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, jsonDataLength);
+/***********************************************************************/
+/* EthereumBudget: the deadline of a call that must complete within a  */
+/*                 latency budget                                      */
+/*                                                                     */
+/*      Inputs: budgetMs = milliseconds from now until the deadline    */
+/*              cancel = set true (from any thread) to cancel the call */
+/*                       or NULL, must outlive the call                */
+/*                                                                     */
+/*     Returns: the deadline to pass to a call                         */
+/*                                                                     */
+/*  Note: The budget is spread across the connect (DNS, TCP and TLS),  */
+/*        any failover and the response, and the call returns timedOut */
+/*        when it is spent or cancelled once cancel is set.            */
+/*                                                                     */
+/***********************************************************************/
+EthereumDeadline EthereumBudget(ui32 budgetMs,
+                                const std::atomic<bool>* cancel)
+{
+  EthereumDeadline deadline;
+
+  deadline.at = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(budgetMs);
+  deadline.cancel = cancel;
+  return deadline;
+}
 
-  struct curl_slist* head = NULL;
+/***********************************************************************/
+/* EthereumAddEndpoint: add a JSON-RPC endpoint to the provider pool   */
+/*                                                                     */
+/*      Inputs: url = the base URL of the endpoint, or ipc://<path> of */
+/*                    the IPC socket of a local node (geth.ipc)        */
+/*              appendId = true to append the infuraId (provider Id)   */
+/*                         of each call to the URL (Infura, Alchemy)   */
+/*                                                                     */
+/*     Returns: zero if added, otherwise otherLicenseError             */
+/*                                                                     */
+/*  Note: Endpoints added replace the default CURL_HOST_URL, add them  */
+/*        in order of preference (used until latency is measured)      */
+/*                                                                     */
+/***********************************************************************/
+int EthereumAddEndpoint(const char* url, bool appendId)
+{
+  std::lock_guard<std::mutex> lock(EndpointLock);
 
-  // Set the content type header to application/json
-  const char* headerContentType = "Content-type: application/json";
-  PRINTF("headerContentType = %s\n", headerContentType);
-  head = curl_slist_append(head, headerContentType);
+  if ((url == NULL) || (strlen(url) + 64 >= MAX_SIZE_URL) ||
+      (Endpoints.size() >= ETHEREUM_MAX_ENDPOINTS))
+    return otherLicenseError;
 
-  // Add the headers to the easy object.
-  curl_easy_setopt(easy, CURLOPT_HTTPHEADER, head);
+  Endpoints.push_back(endpoint_create(url, appendId));
+  return 0;
+}
 
-  // Your URL.
-  const char* url;
-  url = CURL_HOST_URL; //  "http://localhost:8545/"
-  char urlBuf[128];
-  if (strcmp(url, LOCAL_GANACHE_URL) == 0)
-    sprintf(urlBuf, "%s", url);
-  else
-    sprintf(urlBuf, "%s%s", url, infuraId);
+/***********************************************************************/
+/* EthereumClearEndpoints: remove all endpoints from the provider pool */
+/*                                                                     */
+/*  Note: The default CURL_HOST_URL is used until endpoints are added  */
+/*                                                                     */
+/***********************************************************************/
+void EthereumClearEndpoints(void)
+{
+  std::lock_guard<std::mutex> lock(EndpointLock);
 
-  PRINTF("URL = %s\n", urlBuf);
-  curl_easy_setopt(easy, CURLOPT_URL, urlBuf);
+  Endpoints.clear();
+}
+
+/***********************************************************************/
+/* EthereumCheckEndpoints: health check every endpoint of the pool     */
+/*                                                                     */
+/*      Inputs: infuraId = the provider (Infura) Id to use             */
+/*                                                                     */
+/*     Returns: the number of healthy endpoints                        */
+/*                                                                     */
+/***********************************************************************/
+int EthereumCheckEndpoints(const char* infuraId)
+{
+  std::vector<std::shared_ptr<EthereumEndpoint> > endpoints;
+  JsonResponse response;
+  char urlBuf[MAX_SIZE_URL], jsonData[128];
+  int healthy = 0;
 
-  // Perform the HTTP request
-  if (curl_easy_perform(easy) == 0)
   {
-    // Parse the result value and expiration date
-    res = parse_activation_json(curlResponseMemory, exp_dat, languages,
-      version_plat);
+    std::lock_guard<std::mutex> lock(EndpointLock);
+    endpoint_default();
+    endpoints = Endpoints;
   }
-  else
+
+  // Read the latest block number of each endpoint, measuring latency
+  for (size_t i = 0; i < endpoints.size(); i++)
   {
-    PRINTF("Error performing curl request");
-    res = curlPerformFailed;
-  }
+    double msec = 0, waitMs = -1;
+    bool admitted, counted;
+    int res;
 
-  // Destroy easy curl objects and return the result
-  curl_easy_cleanup(easy);
-  curl_global_cleanup();
-  return res;
+    // A health check is low priority, skip endpoints at their limit
+    {
+      std::lock_guard<std::mutex> lock(EndpointLock);
+      admitted = endpoint_admit(endpoints[i].get(), priorityLow, &waitMs);
+      counted = admitted && (endpoints[i]->quota != 0);
+    }
+    if (!admitted)
+      continue;
+    if (counted)
+      quota_sync(endpoints[i]->url.c_str());
+
+    sprintf(jsonData, "{\"jsonrpc\":\"2.0\",\"method\":\"eth_blockNumber\","
+            "\"params\":[],\"id\":%u}", (ui32)JsonRpcId++);
+    endpoint_url(endpoints[i].get(), infuraId, urlBuf);
+    res = ethereum_send_json(urlBuf, jsonData, &response, &msec, NULL);
+    if ((res == 0) && (response.results.empty() ||
+                       !response.results[0].found))
+      res = curlPerformFailed;
+    endpoint_update(endpoints[i].get(), res, msec);
+    if (res == 0)
+      healthy++;
+  }
+  return healthy;
 }
 
 /***********************************************************************/
-/* autolm_read_authentication: productReleaseHashDetails() call,       */
-/*                             parse result                            */
+/* EthereumSetHedging: hedge slow activation and file lookups          */
 /*                                                                     */
-/*      Inputs: infuraId = the Infura ProductID to use                 */
-/*              jsonData = the encoded Json data for function call     */
-/*     Outputs: entityId = the entity identifier that created file     */
-/*              productId = the product identifier of the file         */
-/*              releaseId = the release identifier of the file         */
-/*              languages = the resulting licensed language flags      */
-/*              version = the version of the release (X.X.X.X)         */
-/*              uri = the official URI of the file (to download)       */
+/*      Inputs: percentile = the latency percentile of the endpoint    */
+/*                           (for example 95), after which the call is */
+/*                           also sent to the next endpoint; zero to   */
+/*                           disable hedging (default)                 */
 /*                                                                     */
-/*       Returns: the value of any license activation returned         */
+/*     Returns: zero if set, otherwise otherLicenseError               */
 /*                                                                     */
 /***********************************************************************/
-static int autolm_read_authentication(const char *infuraId,
-    const char *jsonData, ui64 *entityId, ui64 * productId,
-    ui64 * releaseId, ui64 * languages, ui64 * version, char *uri)
+int EthereumSetHedging(int percentile)
 {
-  int res;
+  if ((percentile < 0) || (percentile > 99))
+    return otherLicenseError;
 
-  // For reading an HTML response string into memory with curl
-  char curlResponseMemory[MAX_SIZE_JSON_RESPONSE];
-  curlResponseMemory[0] = 0; // start with empty string
+  HedgePercentile = percentile;
+  return 0;
+}
 
-  // Initialize curl
-  curl_global_init(CURL_GLOBAL_ALL);
+/***********************************************************************/
+/* EthereumSetRateLimit: limit the requests sent to an endpoint        */
+/*                                                                     */
+/*      Inputs: url = the base URL of the endpoint or EthereumNetwork, */
+/*                    NULL for all                                     */
+/*              perSecond = token bucket rate, zero for no rate limit  */
+/*              burst = most requests at once (token bucket size)      */
+/*              dailyQuota = requests per UTC day, zero for unlimited  */
+/*                                                                     */
+/*     Returns: zero if set, otherwise otherLicenseError               */
+/*                                                                     */
+/*  Note: Background requests are refused when less than ten percent  */
+/*        of the daily quota remains, all requests when none remains  */
+/*                                                                     */
+/***********************************************************************/
+int EthereumSetRateLimit(const char* url, double perSecond, ui32 burst,
+                         ui32 dailyQuota)
+{
+  int res = otherLicenseError;
+  std::lock_guard<std::mutex> lock(EndpointLock);
 
-  // Easy object to handle the connection.
-  CURL *easy = curl_easy_init();
+  if ((perSecond < 0) || ((perSecond > 0) && (burst == 0)))
+    return otherLicenseError;
 
-  /* send all data to this function  */
-  curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-                   curl_write_memory_callback);
- 
-  /* we pass our 'chunk' struct to the callback function */
-  curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void *)curlResponseMemory);
- 
-  // You can choose between 1L and 0L (enable verbose log or disable)
-#if AUTOLM_DEBUG
-  curl_easy_setopt(easy, CURLOPT_VERBOSE, 1L);
-#else
-  curl_easy_setopt(easy, CURLOPT_VERBOSE, 0L);
-#endif
-  curl_easy_setopt(easy, CURLOPT_HEADER, 1L);
-//  curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L); //what ???
-   //single call, disable keepalive
-  curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 0L);
-  // Let's create an object which will contain a list of headers.
-  PRINTF("jsonData = %s\n", jsonData);
-  PRINTF("strlen (jsonData) = %d\n", (int)strlen(jsonData));
+  // An EthereumNetwork url not in the provider pool is limited too,
+  //   even before its first request
+  endpoint_default();
+  std::vector<std::shared_ptr<EthereumEndpoint> > endpoints(Endpoints);
+  for (auto it = NetworkEndpoints.begin(); it != NetworkEndpoints.end();
+       ++it)
+    endpoints.push_back(it->second);
+  if (url && (NetworkEndpoints.find(url) == NetworkEndpoints.end()) &&
+      std::none_of(Endpoints.begin(), Endpoints.end(),
+        [url](const std::shared_ptr<EthereumEndpoint>& endpoint)
+        { return endpoint->url == url; }))
+  {
+    if (strlen(url) >= ETHEREUM_URL_SIZE)
+      return otherLicenseError;
+    NetworkEndpoints[url] = endpoint_create(url, false);
+    endpoints.push_back(NetworkEndpoints[url]);
+  }
 
-#ifdef _WINDOWS
-#ifdef _OPENSSL
-  // Point curl to a root certificate store (file required)
-  curl_easy_setopt(easy, CURLOPT_CAINFO, "./cacert.pem");
-#endif
-#endif
+  for (size_t i = 0; i < endpoints.size(); i++)
+  {
+    EthereumEndpoint* endpoint = endpoints[i].get();
 
-  /* Post json data */
-  curl_easy_setopt(easy, CURLOPT_POSTFIELDS, jsonData);
-  unsigned int jsonDataLength = (int)strlen(jsonData);
-  PRINTF("CURLOPT_POSTFIELDSIZE set to jsonDataLength = %d\n",
-         jsonDataLength);
-  /* set the size of the postfields data */
-  curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, jsonDataLength);
+    if (url && (endpoint->url != url))
+      continue;
 
-  struct curl_slist *head = NULL;
- 
-  // Set the content type header to application/json
-  const char* headerContentType = "Content-type: application/json";
-  PRINTF("headerContentType = %s\n", headerContentType);
-  head = curl_slist_append(head, headerContentType);
-
-  // Add the headers to the easy object.
-  curl_easy_setopt(easy, CURLOPT_HTTPHEADER, head);
-
-  // Your URL.
-  const char* url;
-  url = CURL_HOST_URL; //  "http://localhost:8545/"
-  char urlBuf[128];
-  if (strcmp(url, ROPSTEN_INFURA_URL) == 0)
-    sprintf(urlBuf, "%s%s", url, infuraId);
-  else
-    sprintf(urlBuf, "%s", url);
+    // Start with a full bucket
+    endpoint->rate = perSecond;
+    endpoint->burst = burst;
+    endpoint->tokens = burst;
+    endpoint->refilled = std::chrono::steady_clock::now();
+    endpoint->quota = dailyQuota;
+    res = 0;
+  }
+  return res;
+}
 
-  PRINTF("URL = %s\n", urlBuf);
-  curl_easy_setopt(easy, CURLOPT_URL, urlBuf);
- 
-  // Perform the HTTP request
-  if (curl_easy_perform(easy) == 0)
+/***********************************************************************/
+/* EthereumSetQuotaFile: persist the daily request counts to a file    */
+/*                                                                     */
+/*      Inputs: filename = the quota file, shared by the processes of  */
+/*                         the host, or NULL to stop persisting        */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetQuotaFile(const char* filename)
+{
   {
-    // Parse the result value and expiration date
-    res = parse_authentication_json(curlResponseMemory,
-      entityId, productId, releaseId, languages, version, uri);
+    std::lock_guard<std::mutex> lock(EndpointLock);
+    QuotaFile = filename ? filename : "";
   }
-  else
+  quota_sync(NULL);
+}
+
+/***********************************************************************/
+/* EthereumSetSessionCache: persist host addresses and TLS sessions    */
+/*                                                                     */
+/*      Inputs: filename = the session cache file, shared with the     */
+/*                         next process, or NULL to stop persisting    */
+/*                                                                     */
+/*  Note: Call before the first Ethereum call. The next process (for   */
+/*        example the next validate run) connects without DNS and     */
+/*        resumes the TLS session, if libcurl can export sessions     */
+/*                                                                     */
+/***********************************************************************/
+void EthereumSetSessionCache(const char* filename)
+{
   {
-    PRINTF("Error performing curl request");
-    res = curlPerformFailed;
+    std::lock_guard<std::mutex> lock(CurlPoolLock);
+    curl_global_start();
   }
 
-  // Destroy easy curl objects and return the result
-  curl_easy_cleanup(easy);
-  curl_global_cleanup();
-  return res;
+  std::lock_guard<std::mutex> lock(SessionLock);
+
+  SessionFile = filename ? filename : "";
+  SessionHosts.clear();
+  session_free();
+#ifdef ETHEREUM_TLS_SESSIONS
+  SessionTickets.clear();
+#endif
+  if (!SessionFile.empty())
+    session_load();
 }
 
 /***********************************************************************/
-/* Global function definitions                                         */
+/* prewarm_connect: Connect to an endpoint with a JSON-RPC request     */
+/*                                                                     */
+/*      Inputs: endpoint = the endpoint to connect to                  */
+/*              easy = the handle to connect, or NULL for IPC          */
+/*              url = the full endpoint URL                            */
+/*              jsonData = the JSON-RPC request to send                */
+/*                                                                     */
 /***********************************************************************/
+static void prewarm_connect(std::shared_ptr<EthereumEndpoint> endpoint,
+                            CURL* easy, std::string url,
+                            std::string jsonData)
+{
+  JsonResponse response;
+  double msec = 0;
+  int res;
+
+  if (easy == NULL)
+    res = ipc_post_json(url.c_str(), jsonData.c_str(), &response, &msec,
+                        NULL);
+  else
+  {
+    curl_setup_post(easy, url.c_str(), jsonData.c_str(), &response, NULL);
+    res = curl_result(easy, curl_easy_perform(easy), &msec);
+
+    // Pool the connected handle, waking any request waiting for it
+    curl_handle_release(url.c_str(), easy);
+    curl_handle_prewarmed(url.c_str());
+  }
+
+  // The latency includes connecting, so only a failure is recorded
+  if (res != 0)
+    endpoint_update(endpoint.get(), res, msec);
+}
 
 /***********************************************************************/
-/* EthereumValidateActivation: validate a license hash with blockchain */
+/* EthereumPrewarm: connect to the best endpoint in the background     */
 /*                                                                     */
-/*      Inputs: entityId = the Entity Id (creator id) of application   */
-/*              productId = the product Id of the application          */
-/*              hashId = license activation hash identifier to check   */
-/*              infuraId = the Infura ProductId to use for access      */
-/*     Outputs: exp_date = expiration date of the activation (or 0)    */
-/*              languages = language flags for the file                */
-/*              version_plat = version and platform flags              */
+/*      Inputs: infuraId = the provider (Infura) Id to use             */
+/*              network = the network of later calls, NULL for pool    */
 /*                                                                     */
-/*     Returns: the value of any license activation returned           */
+/*     Returns: zero if started or already connected, otherwise        */
+/*              rateLimited or curlPerformFailed                       */
+/*                                                                     */
+/*  Note: DNS resolution and the TLS handshake are done by an          */
+/*        eth_chainId request on a background thread. A call to the    */
+/*        endpoint meanwhile waits for, and uses, this connection.     */
 /*                                                                     */
 /***********************************************************************/
-int EthereumValidateActivation(ui64 entityId, ui64 productId,
-      char* hashId, char* infuraId, time_t* exp_date, ui64* languages,
-      ui64 *version_plat)
+int EthereumPrewarm(const char* infuraId, const EthereumNetwork* network)
 {
-  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
-  char funcId[] = ACTIVATE_STATUS_ID;
+  std::vector<EthereumEndpoint*> tried;
+  std::shared_ptr<EthereumEndpoint> endpoint;
+  char urlBuf[MAX_SIZE_URL], jsonData[128];
+  CURL* easy = NULL;
+  double waitMs;
+  bool limited, open;
 
-  // Encode the function parameters as JSON paramters
-  encode_activate_json(funcId, entityId, productId, hashId, jsonParams);
-  PRINTF("%s\n", jsonParams);
+  if (infuraId == NULL)
+    return otherLicenseError;
 
-  char jsonDataPrefixBuf[256];
-  const char* jsonDataPrefix =
-    "{\"jsonrpc\":\"2.0\",\"method\": \"eth_call\", \"params\":[{\"to\": \"%s\", \"data\":\"";
+  // A low priority request, refused if the daily quota runs low
+  endpoint = endpoint_select(network, tried, priorityLow, &limited,
+                             &waitMs, &open);
+  if (endpoint == NULL)
+    return limited ? rateLimited :
+           (open ? endpointUnavailable : curlPerformFailed);
+  endpoint_url(endpoint.get(), infuraId, urlBuf);
 
-  sprintf(jsonDataPrefixBuf, jsonDataPrefix, IMMUTABLE_ACTIVATE_CONTRACT);
-  PRINTF("jsonDataPrefixBuf = %s\n", jsonDataPrefixBuf);
-  size_t nLengthPrefix = strlen(jsonDataPrefixBuf);
+  if (!endpoint_is_ipc(urlBuf))
+  {
+    easy = curl_handle_acquire(urlBuf, handlePrewarm);
+    if (easy == NULL)
+      return 0;
+  }
 
-    // Hard code the suffix
-    //   (TODO: make 8 a random id and check in response)
-  char jsonDataSuffix[] = "\"}, \"latest\"],\"id\": 8}";
-  PRINTF("jsonDataEndfix = %s\n", jsonDataSuffix);
-  size_t nLengthSuffix = strlen(jsonDataSuffix);
+  sprintf(jsonData, "{\"jsonrpc\":\"2.0\",\"method\":\"eth_chainId\","
+          "\"params\":[],\"id\":%u}", (ui32)JsonRpcId++);
 
-  char jsonDataAll[2048];
-  strcpy(jsonDataAll, jsonDataPrefixBuf);
-
-  // Add the JSON encoded parameters to the buffer
-  size_t nLen = strlen(jsonDataAll);
-  size_t nLengthParams = strlen(jsonParams);
-  strcpy(&jsonDataAll[nLen], jsonParams);
-
-  // Add the data suffix, sanitize and call read_activation
-  nLen = strlen(jsonDataAll);
-  strcpy(&jsonDataAll[strlen(jsonDataAll)], jsonDataSuffix);
-  size_t nDataLength = nLengthPrefix + nLengthParams + nLengthSuffix;
-  jsonDataAll[nDataLength] = 0;
-  PRINTF("jsonData = %s\n", jsonDataAll);
-  return autolm_read_activation(infuraId, jsonDataAll, exp_date,
-                                languages, version_plat);
+  std::lock_guard<std::mutex> lock(PrewarmLock);
+  cleanup_at_exit();
+  PrewarmThreads.push_back(std::thread(prewarm_connect, endpoint, easy,
+                                       std::string(urlBuf),
+                                       std::string(jsonData)));
+  return 0;
 }
 
 /***********************************************************************/
-/* EthereumAuthenticateFile: lookup file authenticity on blockchain    */
+/* EthereumCleanup: close pooled connections and release libcurl       */
 /*                                                                     */
-/*      Inputs: hashId = file SHA256 checksum hex string to lookup     */
-/*              infuraId = Infura ProductId hex string used for access */
-/*     Outputs: entityId = the Entity Id (creator id) of application   */
-/*              productId = the product Id of the application          */
-/*              releaseId = the product release index of file          */
-/*              languages = the 64 bit language flags of file          */
-/*              version = the version, 4 x 16 bits (X.X.X.X)           */
-/*              uri = the URI string pointing to the release file      */
-/*                                                                     */
-/*     Returns: the zero on success, negative on error                 */
+/*  Note: Optional, call once at application exit when no Ethereum     */
+/*        calls are in progress                                        */
 /*                                                                     */
 /***********************************************************************/
-int EthereumAuthenticateFile(const char* hashId,
-  const char* infuraId, ui64* entityId, ui64* productId,
-  ui64* releaseId, ui64* languages, ui64* version, char* uri)
+void EthereumCleanup(void)
 {
-  char jsonParams[(4 * 64) + 10 + 1];// 4x 256 values + 10 functionId + 1
-  char funcId[] = CREATOR_STATUS_ID;
+  // Stop the log subscription and the sync, they use libcurl
+  EthereumUnsubscribeActivations();
+  EthereumStopSync();
 
-  // Encode the function parameters as JSON paramters
-  encode_authenticate_json(funcId, hashId, jsonParams);
-  PRINTF("%s\n", jsonParams);
+  // Wait for background connections, they are pooled below
+  {
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard<std::mutex> lock(PrewarmLock);
+      threads.swap(PrewarmThreads);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+  }
 
-  char jsonDataPrefixBuf[256];
-  const char* jsonDataPrefix =
-    "{\"jsonrpc\":\"2.0\",\"method\": \"eth_call\", \"params\":[{\"to\": \"%s\", \"data\":\"";
+  // Stop the asynchronous event loop, failing any pending requests
+  {
+    std::unique_lock<std::mutex> lock(AsyncLock);
+    if (AsyncRunning)
+    {
+      AsyncRunning = false;
+      AsyncStopping = true;
+      curl_multi_wakeup(AsyncMulti);
+      AsyncIpcWake.notify_one();
+      lock.unlock();
+      AsyncThread.join();
+      AsyncIpcThread.join();
+      async_ipc_fail();
+      lock.lock();
+      curl_multi_cleanup(AsyncMulti);
+      AsyncMulti = NULL;
+      AsyncStopping = false;
+    }
+  }
 
-  // productReleaseHashDetails(uint256) is in ImmutableProduct contract
-  sprintf(jsonDataPrefixBuf, jsonDataPrefix, IMMUTABLE_CREATOR_CONTRACT);
-  PRINTF("jsonDataPrefixBuf = %s\n", jsonDataPrefixBuf);
-  size_t nLengthPrefix = strlen(jsonDataPrefixBuf);
+  // Close the cache file and shared cache, no revalidation is pending
+  {
+    std::lock_guard<std::mutex> lock(CacheLock);
+    cache_file_close();
+    shared_cache_close();
+  }
+  {
+    std::lock_guard<std::mutex> lock(SnapshotLock);
+    snapshot_close();
+  }
+  {
+    std::lock_guard<std::mutex> lock(FilterLock);
+    FilterBits.clear();
+    FilterProducts.clear();
+    FilterSynced = false;
+  }
 
-  // Hard code the suffix
-  //   (TODO: make 8 a random id and check in response)
-  char jsonDataSuffix[] = "\"}, \"latest\"],\"id\": 8}";
-  PRINTF("jsonDataEndfix = %s\n", jsonDataSuffix);
-  size_t nLengthSuffix = strlen(jsonDataSuffix);
+#ifdef ETHEREUM_IPC
+  // Close every idle IPC socket
+  {
+    std::lock_guard<std::mutex> lock(IpcPoolLock);
+    std::map<std::string, std::vector<int> >::iterator it;
+    for (it = IpcPool.begin(); it != IpcPool.end(); ++it)
+    {
+      for (size_t i = 0; i < it->second.size(); i++)
+        close(it->second[i]);
+    }
+    IpcPool.clear();
+  }
+#endif
 
-  char jsonDataAll[2048];
-  strcpy(jsonDataAll, jsonDataPrefixBuf);
-
-  // Add the JSON encoded parameters to the buffer
-  size_t nLen = strlen(jsonDataAll);
-  size_t nLengthParams = strlen(jsonParams);
-  strcpy(&jsonDataAll[nLen], jsonParams);
-
-  // Add the data suffix, sanitize and call read_activation
-  nLen = strlen(jsonDataAll);
-  strcpy(&jsonDataAll[strlen(jsonDataAll)], jsonDataSuffix);
-  size_t nDataLength = nLengthPrefix + nLengthParams + nLengthSuffix;
-  jsonDataAll[nDataLength] = 0;
-  PRINTF("jsonData = %s\n", jsonDataAll);
-  return autolm_read_authentication(infuraId, jsonDataAll, entityId,
-    productId, releaseId, languages, version, uri);
+  std::lock_guard<std::mutex> lock(CurlPoolLock);
+
+  if (CurlInitialized)
+  {
+    // Close every idle connection in the pool
+    std::map<std::string, std::vector<CURL*> >::iterator it;
+    for (it = CurlPool.begin(); it != CurlPool.end(); ++it)
+    {
+      for (size_t i = 0; i < it->second.size(); i++)
+        curl_easy_cleanup(it->second[i]);
+    }
+    CurlPool.clear();
+
+    // No handle uses the share (or the cached addresses) any longer
+    curl_share_cleanup(CurlShare);
+    CurlShare = NULL;
+    {
+      std::lock_guard<std::mutex> sessionLock(SessionLock);
+      session_free();
+    }
+
+    curl_slist_free_all(CurlJsonHeaders);
+    CurlJsonHeaders = NULL;
+    curl_global_cleanup();
+    CurlInitialized = false;
+  }
 }
@@ -32,6 +32,10 @@
 /***********************************************************************/
 #ifndef _ETHEREUMCALLS_H
 #define _ETHEREUMCALLS_H
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <future>
 #ifdef _MIBSIM
 #include "common.h"
 #include "sha1.h"
@@ -57,6 +61,7 @@
 #define CURL_HOST_URL              /*LOCAL_GANACHE_URL*/POLYGON_PUBLIC_URL
 #define IMMUTABLE_ACTIVATE_CONTRACT /*GANACHE_ACTIVATE_CONTRACT*/POLYGON_ACTIVATE_CONTRACT
 #define IMMUTABLE_CREATOR_CONTRACT /*GANACHE_CREATOR_CONTRACT*/POLYGON_CREATOR_CONTRACT
+#define IMMUTABLE_MULTICALL_CONTRACT MULTICALL3_CONTRACT
 
 // Options are Polygon, Ropsten or Local Ganache. Default is public Polygon.
 #define POLYGON_PUBLIC_URL         "https://polygon-rpc.com/"
@@ -64,6 +69,62 @@
 #define ROPSTEN_INFURA_URL         "https://ropsten.infura.io/v3/"
 #define LOCAL_GANACHE_URL          "http://localhost:8545/"
 
+// Connect to the provider in the background during AutoLmInit()
+#define AUTOLM_PREWARM             1 // 0 to connect on first validation
+
+// Maximum JSON-RPC endpoints of the provider pool (EthereumAddEndpoint)
+#define ETHEREUM_MAX_ENDPOINTS     8
+
+// Maximum eth_call requests sent in one JSON-RPC batch (HTTP POST)
+#define ETHEREUM_MAX_BATCH         100
+
+// Maximum activateStatus() calls aggregated into one Multicall3 eth_call
+#define ETHEREUM_MAX_MULTICALL     250
+
+// Maximum length of a JSON-RPC endpoint URL, including any provider id
+#define ETHEREUM_URL_SIZE          256
+
+// Size of the release URI buffer of EthereumAuthenticateFile() without
+//   a uriSize, and of asynchronous file authentication
+#define ETHEREUM_URI_SIZE          512
+
+// Retries of a call after every endpoint failed with a transient error
+#define ETHEREUM_MAX_RETRIES       2
+
+// Longest time a valid activation is cached (EthereumSetCacheTtl)
+#define ETHEREUM_CACHE_TTL_SECONDS 300
+
+// Longest time an activation not found (or expired), or a release not
+//   found, is cached (EthereumSetNegativeCacheTtl)
+#define ETHEREUM_NEGATIVE_TTL_SECONDS 30
+
+// Longest time a valid activation is answered from the cache file
+//   without validating it again (EthereumSetCacheFile)
+#define ETHEREUM_CACHE_GRACE_SECONDS (7 * 24 * 60 * 60)
+
+// Interval of the eth_getLogs sync of the activations of an entity, and
+//   the most blocks read by one eth_getLogs (EthereumStartSync)
+#define ETHEREUM_SYNC_INTERVAL_MS  15000
+#define ETHEREUM_SYNC_RANGE_BLOCKS 2000
+
+// Indexed topic of the activate contract logs holding the Entity Id,
+//   one for the first after the event signature (EthereumStartSync)
+#define ETHEREUM_SYNC_ENTITY_TOPIC 1
+
+// Bits of the activation filter for each valid activation, about 1%
+//   false positives (EthereumBuildFilter)
+#define ETHEREUM_FILTER_BITS       10
+
+// Longest time since a filter was built (or synced) that an activation
+//   not in it is not valid (EthereumSetFilter)
+#define ETHEREUM_FILTER_MAX_AGE_SECONDS (60 * 60)
+
+// Longest wait for each JSON-RPC request of a call without a deadline
+#define ETHEREUM_TIMEOUT_MS        30000
+
+// Session cache file of the command line tools, in $XDG_RUNTIME_DIR
+#define ETHEREUM_SESSION_CACHE     "autolm-session.cache"
+
 // Debugging options
 #define AUTOLM_DEBUG               0 // 1 to Enable debug output
 #if AUTOLM_DEBUG
@@ -83,6 +144,10 @@
 // Keccak256 ("creatorReleaseHashDetails(uint256)") =
 // 0x2d768793fda5eb47e3b2a15fe3b4fd968f844eb7a9f464990378245ba1e00607
 #define CREATOR_STATUS_ID             "0x2d768793"
+// Multicall3
+// Keccak256 ("aggregate3((address,bool,bytes)[])") =
+// 0x82ad56cb4e5648650ea78c1b99c0d15d4876ef8dbbb26387ce567a45cb376af6
+#define MULTICALL_AGGREGATE3_ID       "0x82ad56cb"
 
 // 1.0 deprecated
 //#define ROPSTEN_LICENSE_CONTRACT     "0x21027DD05168A559330649721D3600196aB0aeC2"
@@ -96,15 +161,159 @@
 #define ROPSTEN_CREATOR_CONTRACT "0xA33A9545e0b8cf4F541fbe593E32EeA2d705c67b"
 #define GANACHE_CREATOR_CONTRACT "0xD833215cBcc3f914bD1C9ece3EE7BF8B14f841bb"
 
+// Multicall3 aggregator, deployed at the same address on every network
+//   (deploy it to a local Ganache network before use)
+#define MULTICALL3_CONTRACT      "0xcA11bde05977b3631167028862bE2a173976CA11"
+
+/***********************************************************************/
+/* Type Definitions                                                    */
+/***********************************************************************/
+
+/*
+** Activation lookup of a batch, see EthereumValidateActivations()
+*/
+typedef struct EthereumActivation
+{
+  ui64 entityId;     /* IN  - the Entity Id (creator id) of application */
+  ui64 productId;    /* IN  - the product Id of the application */
+  char hashId[67];   /* IN  - license activation hash identifier */
+  int result;        /* OUT - the AutoLmResponse of the activation */
+  time_t exp_date;   /* OUT - expiration date of the activation (or 0) */
+  ui64 languages;    /* OUT - language flags of the activation */
+  ui64 version_plat; /* OUT - version and platform flags */
+} EthereumActivation;
+
+/*
+** File release lookup, see EthereumAuthenticateFileAsync()
+*/
+typedef struct EthereumRelease
+{
+  char hashId[67];   /* IN  - file SHA256 checksum hex string */
+  int result;        /* OUT - zero if found, otherwise AutoLmResponse */
+  ui64 entityId;     /* OUT - the Entity Id (creator id) of the file */
+  ui64 productId;    /* OUT - the product Id of the file */
+  ui64 releaseId;    /* OUT - the product release index of file */
+  ui64 languages;    /* OUT - the 64 bit language flags of file */
+  ui64 version;      /* OUT - the version, 4 x 16 bits (X.X.X.X) */
+  char uri[ETHEREUM_URI_SIZE]; /* OUT - URI of the release file */
+} EthereumRelease;
+
+/*
+** Blockchain network of a call, empty members use the build options
+*/
+typedef struct EthereumNetwork
+{
+  char url[ETHEREUM_URL_SIZE]; /* JSON-RPC or ipc:// URL, empty for pool */
+  bool appendId;               /* append the provider id to the url */
+  char activateContract[43];   /* activate token contract address */
+  char creatorContract[43];    /* creator token contract address */
+  char multicallContract[43];  /* Multicall3 contract address */
+} EthereumNetwork;
+
+/*
+** Deadline of a call, and its cancellation, see EthereumBudget()
+*/
+typedef struct EthereumDeadline
+{
+  std::chrono::steady_clock::time_point at; /* timedOut after this time */
+  const std::atomic<bool>* cancel; /* cancelled once true, or NULL */
+} EthereumDeadline;
+
+/*
+** Asynchronous result callbacks, called from the event loop thread
+*/
+typedef void (*EthereumActivationCallback)(
+  const EthereumActivation* activation, void* context);
+typedef void (*EthereumReleaseCallback)(const EthereumRelease* release,
+  void* context);
+
 /***********************************************************************/
 /* Global function declarations                                        */
 /***********************************************************************/
 int EthereumValidateActivation(ui64 entityId, ui64 productId,
   char* hashId, char* infuraId, time_t* exp_date, ui64* languages,
-  ui64* version_plat);
+  ui64* version_plat, const EthereumNetwork* network = NULL,
+  const EthereumDeadline* deadline = NULL);
+
+int EthereumValidateActivations(EthereumActivation* activations,
+  int count, const char* infuraId, const EthereumNetwork* network = NULL,
+  const EthereumDeadline* deadline = NULL);
+
+int EthereumValidateActivationsMulticall(EthereumActivation* activations,
+  int count, const char* infuraId, const EthereumNetwork* network = NULL,
+  const EthereumDeadline* deadline = NULL);
 
 int EthereumAuthenticateFile(const char* hashId, const char* infuraId,
   ui64* entityId, ui64* productId, ui64* releaseId, ui64* languages,
-  ui64* version, char* uri);
+  ui64* version, char* uri, const EthereumNetwork* network = NULL,
+  const EthereumDeadline* deadline = NULL);
+int EthereumAuthenticateFile(const char* hashId, const char* infuraId,
+  ui64* entityId, ui64* productId, ui64* releaseId, ui64* languages,
+  ui64* version, char* uri, size_t* uriSize,
+  const EthereumNetwork* network = NULL,
+  const EthereumDeadline* deadline = NULL);
+
+int EthereumValidateActivationAsync(ui64 entityId, ui64 productId,
+  const char* hashId, const char* infuraId,
+  EthereumActivationCallback callback, void* context,
+  const EthereumNetwork* network = NULL);
+std::future<EthereumActivation> EthereumValidateActivationAsync(
+  ui64 entityId, ui64 productId, const char* hashId,
+  const char* infuraId, const EthereumNetwork* network = NULL);
+
+int EthereumAuthenticateFileAsync(const char* hashId, const char* infuraId,
+  EthereumReleaseCallback callback, void* context,
+  const EthereumNetwork* network = NULL);
+std::future<EthereumRelease> EthereumAuthenticateFileAsync(
+  const char* hashId, const char* infuraId,
+  const EthereumNetwork* network = NULL);
+
+void EthereumSetCacheTtl(ui32 seconds);
+void EthereumClearCache(void);
+void EthereumSetCacheRefresh(ui32 percent);
+void EthereumSetBlockPolling(ui32 intervalMs);
+int EthereumSubscribeActivations(const char* url,
+  const EthereumNetwork* network = NULL);
+void EthereumUnsubscribeActivations(void);
+int EthereumStartSync(ui64 entityId, const ui64* productIds, int count,
+  ui64 fromBlock, const char* infuraId,
+  const EthereumNetwork* network = NULL,
+  ui32 intervalMs = ETHEREUM_SYNC_INTERVAL_MS);
+void EthereumStopSync(void);
+int EthereumExportSnapshot(const char* filename, const ui8* key,
+  ui32 keyLength, ui32* count = NULL);
+int EthereumSetSnapshot(const char* filename, const ui8* key,
+  ui32 keyLength);
+int EthereumBuildFilter(ui32 bitsPerActivation = ETHEREUM_FILTER_BITS,
+  ui32 maxAgeSeconds = ETHEREUM_FILTER_MAX_AGE_SECONDS);
+int EthereumExportFilter(const char* filename, const ui8* key,
+  ui32 keyLength);
+int EthereumSetFilter(const char* filename, const ui8* key,
+  ui32 keyLength, ui32 maxAgeSeconds = ETHEREUM_FILTER_MAX_AGE_SECONDS);
+bool EthereumFilterActivation(ui64 entityId, ui64 productId,
+  const char* hashId);
+void EthereumFilterAdd(ui64 entityId, ui64 productId, const char* hashId);
+void EthereumSetNegativeCacheTtl(ui32 seconds);
+void EthereumClearNegativeCache(void);
+int EthereumSetCacheFile(const char* filename, const ui8* key,
+  ui32 keyLength, ui32 graceSeconds = ETHEREUM_CACHE_GRACE_SECONDS);
+int EthereumSetSharedCache(const char* name, const ui8* key,
+  ui32 keyLength);
+
+EthereumDeadline EthereumBudget(ui32 budgetMs,
+  const std::atomic<bool>* cancel = NULL);
+
+int EthereumAddEndpoint(const char* url, bool appendId);
+void EthereumClearEndpoints(void);
+int EthereumCheckEndpoints(const char* infuraId);
+int EthereumSetHedging(int percentile);
+int EthereumSetRateLimit(const char* url, double perSecond, ui32 burst,
+  ui32 dailyQuota);
+void EthereumSetQuotaFile(const char* filename);
+void EthereumSetSessionCache(const char* filename);
+int EthereumPrewarm(const char* infuraId,
+  const EthereumNetwork* network = NULL);
+
+void EthereumCleanup(void);
 
 #endif /* _ETHEREUMCALLS_H */
@@ -237,6 +237,10 @@ int main()
      char buyHashId[44] = "";
      char purchaseUrl[244] = "";
      unsigned int nVendorPwdLength;
+     bool purchaseLaunched = false;
+#ifdef _UNIX
+     char answer[16];
+#endif /* ifdef _UNIX */
 
      // Reconfigure entity and product below to match Ecosystem
      const char* entityName = "Software Creator"; //From Immutable Ecosystem
@@ -283,8 +287,30 @@ int main()
          // If no license not valid on-chain/expired, launch Dapp to purchase
          case blockchainExpiredLicense:
 
-           // launch browser to purchase from Immutable
-           launchPurchaseDialog(entityId, productId, buyHashId, purchaseUrl);
+           // launch browser to purchase from Immutable, once
+           if (!purchaseLaunched)
+           {
+             launchPurchaseDialog(entityId, productId, buyHashId, purchaseUrl);
+             purchaseLaunched = true;
+           }
+
+           // Once the user completes the purchase it activates on-chain,
+           //   so validate again from the blockchain rather than the
+           //   cached expired result (or a filter built before)
+#ifndef _UNIX
+           if (MessageBoxA(hWnd, "Validate the activation again once the "
+                           "purchase completes?", "Activation",
+                           MB_OKCANCEL) == IDOK)
+#else /* ifndef _UNIX */
+           puts("Press Enter once the purchase completes, or q to exit.");
+           if ((fgets(answer, sizeof(answer), stdin) != NULL) &&
+               (answer[0] != 'q') && (answer[0] != 'Q'))
+#endif /* ifndef _UNIX */
+           {
+             EthereumClearNegativeCache();
+             EthereumFilterAdd(entityId, productId, buyHashId);
+             continue;
+           }
            break;
          default:
            break;
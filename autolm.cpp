@@ -93,6 +93,36 @@ int DECLARE(AutoLm) AutoLmInit(const char* entity, ui64 entityId,
                                int mode, const char* password,
                                ui32 pwdLength, int (*computer_id)(char*),
                                const char* infuraId)
+{
+  return AutoLmInit(entity, entityId, product, productId, mode, password,
+                    pwdLength, computer_id, infuraId, NULL);
+}
+
+/***********************************************************************/
+/* AutoLmInit: Initialize AutoLM with entity/product credentials and   */
+/*             the blockchain network of this instance                 */
+/*                                                                     */
+/*      Inputs: entity = full entity name (may change)                 */
+/*              entityId =  the Immutable Entity Id                    */
+/*              product =  full product name (may change)              */
+/*              productId = the Immutable Entity specific Product Id   */
+/*              mode = cryptographic algorithm to use for hash         */
+/*              password =  password seeded into cryptographic hash    */
+/*              pwdLength =  password length in bytes                  */
+/*              computer_id =  optional function to generate comp id   */
+/*              infuraId =  the Infura product Id assigned the creator */
+/*              network = the endpoint and contracts of this instance, */
+/*                        NULL for the provider pool and build options */
+/*                                                                     */
+/*     Returns: 0 if success, otherwise an error occurred              */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmInit(const char* entity, ui64 entityId,
+                               const char* product, ui64 productId,
+                               int mode, const char* password,
+                               ui32 pwdLength, int (*computer_id)(char*),
+                               const char* infuraId,
+                               const EthereumNetwork* network)
 {
   ui8 compid_octet[36];
   int compidlen;
@@ -102,8 +132,22 @@ int DECLARE(AutoLm) AutoLmInit(const char* entity, ui64 entityId,
     return otherLicenseError;
 
 #ifndef _CREATEONLY
-  if (infuraId == NULL)
+  if ((infuraId == NULL) ||
+      (strlen(infuraId) >= sizeof(AutoLmOne.infuraProductId)))
     return otherLicenseError;
+  strcpy(AutoLmOne.infuraProductId, infuraId);
+
+  // The network of this instance, otherwise the build options
+  if (network)
+    AutoLmOne.network = *network;
+  else
+    memset(&AutoLmOne.network, 0, sizeof(AutoLmOne.network));
+
+#if AUTOLM_PREWARM
+  // Connect to the provider while the computer id is read, the
+  //   connection is ready for AutoLmValidateLicense()
+  EthereumPrewarm(AutoLmOne.infuraProductId, &AutoLmOne.network);
+#endif
 #endif
 
   strcpy(AutoLmOne.entity, entity);
@@ -161,20 +205,19 @@ int DECLARE(AutoLm) AutoLmInit(const char* entity, ui64 entityId,
 #ifndef _CREATEONLY
 
 /***********************************************************************/
-/* AutoLmValidateLicense: Determine validity of a license file         */
+/* AutoLmReadLicense: Read and authenticate a local license file       */
 /*                                                                     */
 /*       Input: filename = full filename of license file (may change)  */
-/*     Outputs: exp_date = the resulting expiration day/time           */
-/*              buyHashId = resulting activation hash to purchase      */
-/*              languages = resulting language limitations             */
-/*              version_plat = resulting version or platform limits    */
+/*     Outputs: entityId = the entity id of the license activation     */
+/*              productId = the product id of the license activation   */
+/*              hashId = the activation hash (44 bytes) to validate    */
 /*                                                                     */
-/*     Returns: the immutable value of license, otherwise zero (0)     */
+/*     Returns: licenseValid if the license needs blockchain validation*/
+/*              of the activation, otherwise error                     */
 /*                                                                     */
 /***********************************************************************/
-int DECLARE(AutoLm) AutoLmValidateLicense(const char *filename,
-                    time_t *exp_date, char* buyHashId, ui64 *languages,
-                    ui64 *version_plat)
+int DECLARE(AutoLm) AutoLmReadLicense(const char *filename,
+                    ui64 *entityId, ui64 *productId, char *hashId)
 {
   FILE *pFILE;
   char tmp[170],tmpstr[170], tmpstr1[170];
@@ -475,26 +518,16 @@ int DECLARE(AutoLm) AutoLmValidateLicense(const char *filename,
     // Close the license file
     fclose(pFILE);
 
-    // If a license found and valid, check Ethereum database
+    // If a license found and valid, Ethereum database check is needed
     if (in_entity && in_app && app_parsed && (rval == licenseValid))
     {
       PRINTF("llEntityId = %llu, llProductId = %llu\n", loc_entityid,
              loc_productid);
 
-      // Query the Ethereum database for the activation value
-      rval = EthereumValidateActivation(loc_entityid, loc_productid,
-                                        loc_hash, // hash is activation
-                                        AutoLmOne.infuraProductId,
-                                        exp_date, languages, version_plat);
-
-      // If the license is expired copy the activation id for caller
-      if (rval == blockchainExpiredLicense)
-      {
-          strcpy(buyHashId, loc_hash);
-          PRINTF("buyHashId-%s\n", buyHashId);
-      }
-
-      // Return success or error, resultValue has activation value
+      // Return the activation to query the Ethereum database for
+      *entityId = loc_entityid;
+      *productId = loc_productid;
+      strcpy(hashId, loc_hash); // hash is activation
       return rval;
     }
 
@@ -509,6 +542,288 @@ done:
   fclose(pFILE);
   return rval;
 }
+
+/***********************************************************************/
+/* AutoLmValidateLicense: Determine validity of a license file         */
+/*                                                                     */
+/*       Input: filename = full filename of license file (may change)  */
+/*     Outputs: exp_date = the resulting expiration day/time           */
+/*              buyHashId = resulting activation hash to purchase      */
+/*              languages = resulting language limitations             */
+/*              version_plat = resulting version or platform limits    */
+/*                                                                     */
+/*     Returns: the immutable value of license, otherwise zero (0)     */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmValidateLicense(const char *filename,
+                    time_t *exp_date, char* buyHashId, ui64 *languages,
+                    ui64 *version_plat)
+{
+  return AutoLmValidateLicense(filename, exp_date, buyHashId, languages,
+                               version_plat, NULL);
+}
+
+/***********************************************************************/
+/* AutoLmValidateLicense: Determine validity of a license file within  */
+/*                        a deadline, for example EthereumBudget(50)   */
+/*                                                                     */
+/*       Input: filename = full filename of license file (may change)  */
+/*              deadline = the deadline and cancellation of the call   */
+/*     Outputs: exp_date = the resulting expiration day/time           */
+/*              buyHashId = resulting activation hash to purchase      */
+/*              languages = resulting language limitations             */
+/*              version_plat = resulting version or platform limits    */
+/*                                                                     */
+/*     Returns: the immutable value of license, timedOut if the        */
+/*              deadline passed, cancelled if cancelled, otherwise     */
+/*              zero (0)                                               */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmValidateLicense(const char *filename,
+                    time_t *exp_date, char* buyHashId, ui64 *languages,
+                    ui64 *version_plat, const EthereumDeadline* deadline)
+{
+  char loc_hash[44];
+  ui64 loc_entityid = 0, loc_productid = 0;
+  int rval;
+
+  // Read the local license file, return if invalid
+  rval = AutoLmReadLicense(filename, &loc_entityid, &loc_productid,
+                           loc_hash);
+  if (rval != licenseValid)
+    return rval;
+
+  // An activation the filter rejects is not valid, without the query
+  if (!EthereumFilterActivation(loc_entityid, loc_productid, loc_hash))
+  {
+    if (exp_date)
+      *exp_date = 0;
+    if (languages)
+      *languages = 0;
+    if (version_plat)
+      *version_plat = 0;
+    rval = blockchainExpiredLicense;
+  }
+
+  // Otherwise query the Ethereum database for the activation value
+  else
+    rval = EthereumValidateActivation(loc_entityid, loc_productid,
+                                      loc_hash, // hash is activation
+                                      AutoLmOne.infuraProductId,
+                                      exp_date, languages, version_plat,
+                                      &AutoLmOne.network, deadline);
+
+  // If the license is expired copy the activation id for caller
+  if (rval == blockchainExpiredLicense)
+  {
+      strcpy(buyHashId, loc_hash);
+      PRINTF("buyHashId-%s\n", buyHashId);
+  }
+
+  // Return success or error, resultValue has activation value
+  return rval;
+}
+
+/***********************************************************************/
+/* AutoLmValidateLicenseAsync: Determine validity of a license file    */
+/*                             without blocking on the blockchain      */
+/*                                                                     */
+/*       Input: filename = full filename of license file (may change)  */
+/*              callback = function called with the activation result  */
+/*                         from the event loop thread (do not block)   */
+/*              context = caller data passed through to the callback   */
+/*                                                                     */
+/*     Returns: zero if the blockchain validation is queued, otherwise */
+/*              the error of the local license file (no callback)      */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmValidateLicenseAsync(const char *filename,
+                    EthereumActivationCallback callback, void* context)
+{
+  char loc_hash[44];
+  ui64 loc_entityid = 0, loc_productid = 0;
+  int rval;
+
+  // Read the local license file, return if invalid
+  rval = AutoLmReadLicense(filename, &loc_entityid, &loc_productid,
+                           loc_hash);
+  if (rval != licenseValid)
+    return rval;
+
+  // Queue the Ethereum database query, the callback has the result.
+  //   If expired, the callback activation hashId is the buyHashId.
+  return EthereumValidateActivationAsync(loc_entityid, loc_productid,
+                                         loc_hash,
+                                         AutoLmOne.infuraProductId,
+                                         callback, context,
+                                         &AutoLmOne.network);
+}
+
+/***********************************************************************/
+/* AutoLmValidateLicenseAsync: Determine validity of a license file    */
+/*                             as a std::future                        */
+/*                                                                     */
+/*       Input: filename = full filename of license file (may change)  */
+/*                                                                     */
+/*     Returns: the future activation, result is the AutoLmResponse    */
+/*              and hashId the buyHashId if expired                    */
+/*                                                                     */
+/***********************************************************************/
+std::future<EthereumActivation> DECLARE(AutoLm) AutoLmValidateLicenseAsync(
+                    const char *filename)
+{
+  char loc_hash[44];
+  ui64 loc_entityid = 0, loc_productid = 0;
+  int rval;
+
+  // Read the local license file, the future is ready if invalid (or
+  //   the filter rejects the activation)
+  rval = AutoLmReadLicense(filename, &loc_entityid, &loc_productid,
+                           loc_hash);
+  if ((rval == licenseValid) &&
+      !EthereumFilterActivation(loc_entityid, loc_productid, loc_hash))
+    rval = blockchainExpiredLicense;
+  if (rval != licenseValid)
+  {
+    std::promise<EthereumActivation> promise;
+    EthereumActivation activation;
+
+    memset(&activation, 0, sizeof(activation));
+    activation.result = rval;
+    if (rval == blockchainExpiredLicense)
+    {
+      activation.entityId = loc_entityid;
+      activation.productId = loc_productid;
+      strncpy(activation.hashId, loc_hash, sizeof(activation.hashId) - 1);
+    }
+    promise.set_value(activation);
+    return promise.get_future();
+  }
+
+  // Otherwise the future of the Ethereum database query
+  return EthereumValidateActivationAsync(loc_entityid, loc_productid,
+                                         loc_hash,
+                                         AutoLmOne.infuraProductId,
+                                         &AutoLmOne.network);
+}
+
+/***********************************************************************/
+/* AutoLmSetCacheFile: Keep valid license activations in a local file  */
+/*                     for fast startup and offline grace periods      */
+/*                                                                     */
+/*       Input: filename = full filename of the cache file, or NULL to */
+/*                         close it                                    */
+/*              graceSeconds = longest time an activation is valid     */
+/*                             from the file without the blockchain    */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: Call after AutoLmInit(), the file records are authenticated  */
+/*        with the localized password so are only valid on this        */
+/*        computer                                                     */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmSetCacheFile(const char *filename,
+                                       ui32 graceSeconds)
+{
+  if ((AutoLmOne.mode != 2) && (AutoLmOne.mode != 3))
+    return otherLicenseError;
+
+  // The localized password is the HMAC key of the cache file records
+  return EthereumSetCacheFile(filename, AutoLmOne.password,
+                              (AutoLmOne.mode == 3) ? 20 : 16,
+                              graceSeconds);
+}
+
+/***********************************************************************/
+/* AutoLmSetSharedCache: Share valid license activations with the      */
+/*                       other processes of this application on this   */
+/*                       computer                                      */
+/*                                                                     */
+/*       Input: name = the POSIX shared memory name ("/name"), or NULL */
+/*                     to stop sharing                                 */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: Call after AutoLmInit(), results are authenticated with the  */
+/*        localized password so are only shared by processes with the */
+/*        same password on this computer                               */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmSetSharedCache(const char *name)
+{
+  if ((AutoLmOne.mode != 2) && (AutoLmOne.mode != 3))
+    return otherLicenseError;
+
+  // The localized password is the HMAC key of the shared results
+  return EthereumSetSharedCache(name, AutoLmOne.password,
+                                (AutoLmOne.mode == 3) ? 20 : 16);
+}
+
+/***********************************************************************/
+/* AutoLmStartSync: Answer license activations of the application      */
+/*                  from a local index, synced with the blockchain     */
+/*                                                                     */
+/*       Input: fromBlock = the first block to backfill, zero to       */
+/*                          follow from the chain head                 */
+/*              intervalMs = milliseconds between syncs                */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: Call after AutoLmInit(), see EthereumStartSync() to sync     */
+/*        every product of the entity. EthereumStopSync() stops it.    */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmStartSync(ui64 fromBlock, ui32 intervalMs)
+{
+  return EthereumStartSync(AutoLmOne.entityid, &AutoLmOne.productid, 1,
+                           fromBlock, AutoLmOne.infuraProductId,
+                           &AutoLmOne.network, intervalMs);
+}
+
+/***********************************************************************/
+/* AutoLmSetSnapshot: Answer license activations of the application    */
+/*                    from a snapshot file, for nodes without the      */
+/*                    blockchain                                       */
+/*                                                                     */
+/*      Inputs: filename = the snapshot file, or NULL to close it      */
+/*              key = the HMAC key the snapshot was exported with      */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: See EthereumExportSnapshot() and the snapshot tool to export */
+/*        the activations of the entity.                               */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmSetSnapshot(const char* filename, const ui8* key,
+                                      ui32 keyLength)
+{
+  return EthereumSetSnapshot(filename, key, keyLength);
+}
+
+/***********************************************************************/
+/* AutoLmSetFilter: Reject license activations of the application not  */
+/*                  in a filter file, without the blockchain           */
+/*                                                                     */
+/*      Inputs: filename = the filter file, or NULL to remove it       */
+/*              key = the HMAC key the filter was exported with        */
+/*              keyLength = the length of the key, up to 64 bytes      */
+/*              maxAgeSeconds = longest time since the filter was      */
+/*                              built that it rejects activations      */
+/*                                                                     */
+/*     Returns: zero on success, otherwise otherLicenseError           */
+/*                                                                     */
+/*  Note: See EthereumBuildFilter() and EthereumExportFilter() to      */
+/*        build the filter from the activations of the entity, and     */
+/*        EthereumFilterAdd() after a purchase.                        */
+/*                                                                     */
+/***********************************************************************/
+int DECLARE(AutoLm) AutoLmSetFilter(const char* filename, const ui8* key,
+                                    ui32 keyLength, ui32 maxAgeSeconds)
+{
+  return EthereumSetFilter(filename, key, keyLength, maxAgeSeconds);
+}
 #endif /* ifndef _CREATEONLY */
 
 /***********************************************************************/
@@ -68,7 +68,13 @@ enum AutoLmResponse
   blockchainAuthenticationFailed,
   curlPerformFailed,
   applicationFeature, // Not an error necessarily
-  otherLicenseError
+  otherLicenseError,
+  rateLimited, // Rate limit or daily quota of the endpoint reached
+  uriTooLong, // Release URI truncated to the size of the uri buffer
+  timedOut, // Deadline of the call passed before the provider answered
+  cancelled, // Call cancelled by the caller
+  requestRejected, // Endpoint rejected the request (bad URL or provider id)
+  endpointUnavailable // Circuit breaker of every endpoint open, failed fast
 };
 
 /*
@@ -87,6 +93,7 @@ typedef struct AutoLmConfig
   int (*getComputerId)(char *);
   char computerId[35];
   char infuraProductId[35];
+  EthereumNetwork network;
 } AutoLmConfig;
 
 /***********************************************************************/
@@ -111,10 +118,33 @@ public:
                  ui64 productId, int mode, const char* password,
                  ui32 pwdLength, int (*computer_id)(char*),
                  const char* infuraId);
+  int AutoLmInit(const char* entity, ui64 entityId, const char* product,
+                 ui64 productId, int mode, const char* password,
+                 ui32 pwdLength, int (*computer_id)(char*),
+                 const char* infuraId, const EthereumNetwork* network);
 
   int AutoLmValidateLicense(const char* filename, time_t *exp_date,
                             char* buyActivationId, ui64 *langauges,
                             ui64 *version_plat);
+  int AutoLmValidateLicense(const char* filename, time_t *exp_date,
+                            char* buyActivationId, ui64 *langauges,
+                            ui64 *version_plat,
+                            const EthereumDeadline* deadline);
+  int AutoLmValidateLicenseAsync(const char* filename,
+                                 EthereumActivationCallback callback,
+                                 void* context);
+  std::future<EthereumActivation> AutoLmValidateLicenseAsync(
+                                 const char* filename);
+  int AutoLmSetCacheFile(const char* filename,
+                         ui32 graceSeconds = ETHEREUM_CACHE_GRACE_SECONDS);
+  int AutoLmSetSharedCache(const char* name);
+  int AutoLmStartSync(ui64 fromBlock,
+                      ui32 intervalMs = ETHEREUM_SYNC_INTERVAL_MS);
+  int AutoLmSetSnapshot(const char* filename, const ui8* key,
+                        ui32 keyLength);
+  int AutoLmSetFilter(const char* filename, const ui8* key,
+                      ui32 keyLength,
+                      ui32 maxAgeSeconds = ETHEREUM_FILTER_MAX_AGE_SECONDS);
   int AutoLmCreateLicense(const char* filename);
 
   int AutoLmPwdStringToBytes(const char* password, char* byteResult);
@@ -123,6 +153,8 @@ private:
   /*********************************************************************/
   /* Private  declarations                                             */
   /*********************************************************************/
+  int AutoLmReadLicense(const char* filename, ui64 *entityId,
+                        ui64 *productId, char *hashId);
   int AutoLmStringToHex(const char *hexstring, ui8 *result);
   int AutoLmHashLicense(const char *appstr, const char *computerid,
                         ui8 *hashresult);
@@ -0,0 +1,145 @@
+/***********************************************************************/
+/*                                                                     */
+/*   Module:  snapshot.cpp                                             */
+/*   Version: 2020.0                                                   */
+/*   Purpose: Command line export of activations to a snapshot file    */
+/*                                                                     */
+/*---------------------------------------------------------------------*/
+/*                                                                     */
+/*                 Copyright © 2020 ImmutableSoft Inc.                 */
+/*                                                                     */
+/* Permission is hereby granted, free of charge, to any person         */
+/* obtaining a copy of this software and associated documentation      */
+/* files (the “Software”), to deal in the Software without             */
+/* restriction, including without limitation the rights to use, copy,  */
+/* modify, merge, publish, distribute, sublicense, and/or sell copies  */
+/* of the Software, and to permit persons to whom the Software is      */
+/* furnished to do so, subject to the following conditions:            */
+/*                                                                     */
+/* The above copyright notice and this permission notice shall be      */
+/* included in all copies or substantial portions of the Software.     */
+/*                                                                     */
+/* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,     */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF  */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND               */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN  */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN   */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE    */
+/* SOFTWARE.                                                           */
+/*                                                                     */
+/***********************************************************************/
+#include <time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "autolm.h"
+
+/***********************************************************************/
+/*        main: Main application entry point                           */
+/*                                                                     */
+/*      Inputs: argc = the number of command line parameters (7 to 9)  */
+/*              argv = array of individual command line parameters     */
+/*                                                                     */
+/*     Returns: Zero on successful export, otherwise error             */
+/*                                                                     */
+/***********************************************************************/
+int main(int argc, const char **argv)
+{
+  int res, seconds = 300;
+  ui32 count = 0;
+  ui64 entityId, fromBlock;
+  std::vector<ui64> productIds;
+  const char* products;
+  char* end;
+
+  // Executable name, Entity, Products, Block, Infura, File, Key, [Time],
+  //   [Filter]
+  if ((argc < 7) || (argc > 9))
+  {
+    printf("Invalid number of arguments %d", argc);
+    puts("");
+    puts("snapshot <entity id> <product ids> <from block> <infura id> <file> <key> [seconds] [filter]");
+    puts("");
+    puts("  Export the activations of an entity to a snapshot file.");
+    puts("    Nodes without the blockchain look up activations in the");
+    puts("    file, see AutoLmSetSnapshot().");
+    puts("");
+    puts("  <entity id>   The entity id of the creator");
+    puts("  <product ids> The product ids to export, comma separated");
+    puts("  <from block>  The block of the first activation to export");
+    puts("  <infura id>   Your infura.io product id");
+    puts("  <file>        The snapshot file to write");
+    puts("  <key>         The key the nodes authenticate the file with");
+    puts("  [seconds]     The longest to sync with the blockchain, 300");
+    puts("  [filter]      The filter file of the activations to write,");
+    puts("                see AutoLmSetFilter(), <from block> must be");
+    puts("                the deploy block of the activate contract");
+
+    return -1;
+  }
+
+  // Parse the entity, every product and the first block
+  entityId = strtoull(argv[1], NULL, 10);
+  for (products = argv[2]; *products; products = end)
+  {
+    productIds.push_back(strtoull(products, &end, 10));
+    if (end == products)
+      break;
+    if (*end == ',')
+      ++end;
+  }
+  fromBlock = strtoull(argv[3], NULL, 10);
+  if (argc >= 8)
+    seconds = atoi(argv[7]);
+  if ((entityId == 0) || productIds.empty() || (strlen(argv[6]) > 64))
+  {
+    puts("ERROR - Invalid entity id, product ids or key (up to 64 characters)");
+    return -1;
+  }
+
+  // Sync the activations of the entity from the blockchain
+  res = EthereumStartSync(entityId, productIds.data(), (int)productIds.size(),
+                          fromBlock, argv[4]);
+  if (res != 0)
+  {
+    printf("ERROR - Sync of entity %llu failed, error %d\n", entityId, res);
+    return res;
+  }
+  printf("  Syncing activations of entity %llu from block %llu\n",
+         entityId, fromBlock);
+
+  // Export once synced to the chain head, or until out of time
+  do
+  {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    res = EthereumExportSnapshot(argv[5], (const ui8*)argv[6],
+                                 (ui32)strlen(argv[6]), &count);
+  } while ((res != 0) && (--seconds > 0));
+
+  // Output the result of the export
+  if (res == 0)
+    printf("  Exported %u activations to %s\n", count, argv[5]);
+  else
+    printf("ERROR - Not synced with the blockchain in time, error %d\n", res);
+
+  // Build and export the filter of the activations, if requested
+  if ((res == 0) && (argc == 9))
+  {
+    res = EthereumBuildFilter();
+    if (res == 0)
+      res = EthereumExportFilter(argv[8], (const ui8*)argv[6],
+                                 (ui32)strlen(argv[6]));
+    if (res == 0)
+      printf("  Exported the filter of the activations to %s\n", argv[8]);
+    else
+      printf("ERROR - Filter not exported, error %d\n", res);
+  }
+  EthereumStopSync();
+  EthereumCleanup();
+  return res;
+}
@@ -150,6 +150,16 @@ int main(int argc, const char **argv)
   PRINTF(" %d Validating license file...", res);
   if (res == 0)
   {
+    // Reuse the DNS and TLS session of the last run, if a runtime dir
+    const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && runtimeDir[0])
+    {
+      char cacheFile[512];
+      snprintf(cacheFile, sizeof(cacheFile), "%s/%s", runtimeDir,
+               ETHEREUM_SESSION_CACHE);
+      EthereumSetSessionCache(cacheFile);
+    }
+
     time_t expireTime = 0;
     char buyHashId[67] = "";
     ui64 languages = 0, version_plat = 0;